@@ -0,0 +1,105 @@
+#!/usr/bin/python3
+#
+#  protocol_bench.py
+#  
+#  Author:  Martin Timms
+#  Date:    14th July 2023.
+#  Contributors:
+#  Version: 1.0
+#
+#  Released into the public domain.
+#  
+#  License: MIT License
+#
+#  Description: Measures frequency commands per second over the text protocol and the
+#  binary framed protocol (see src/binary_protocol.h). Each command waits for its reply
+#  before the next one is sent, as an automated rig would.
+#
+
+import argparse
+import struct
+import time
+
+import serial
+
+SYNC = 0xA5
+MAGIC = 0x5A
+OP_EXIT = 0x7F
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def frame(opcode, payload=b""):
+    body = bytes([len(payload) + 1, opcode]) + payload
+    return bytes([SYNC]) + body + struct.pack("<H", crc16(body))
+
+
+def read_reply(ser):
+    # resynchronise on the sync byte, then check the length and CRC
+    while True:
+        b = ser.read(1)
+        if not b:
+            raise SystemExit("binary reply timeout")
+        if b[0] != SYNC:
+            continue
+        rest = ser.read(13)
+        if len(rest) == 13 and rest[0] == 10 and crc16(rest[:11]) == struct.unpack("<H", rest[11:])[0]:
+            opcode, status, value = struct.unpack("<BBQ", rest[1:11])
+            return opcode & 0x7F, status, value
+
+
+def bench_text(ser, freqs):
+    start = time.perf_counter()
+    for f in freqs:
+        ser.write(b"F%d\n" % f)
+        while True:
+            line = ser.readline()
+            if not line:
+                raise SystemExit("text reply timeout")
+            if line.startswith(b"Step Frequency set to") or line.startswith(b"Frequency not set"):
+                break
+    return len(freqs) / (time.perf_counter() - start)
+
+
+def bench_binary(ser, freqs):
+    ser.write(bytes([SYNC, MAGIC]))
+    read_reply(ser)
+    start = time.perf_counter()
+    for f in freqs:
+        ser.write(frame(ord("F") - ord("A") + 1, struct.pack("<I", f)))
+        _, status, _ = read_reply(ser)
+        if status != 0:
+            raise SystemExit("binary status %d" % status)
+    rate = len(freqs) / (time.perf_counter() - start)
+    ser.write(frame(OP_EXIT))
+    read_reply(ser)
+    return rate
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Text vs binary protocol command rate")
+    parser.add_argument("port", help="serial port, e.g. /dev/ttyACM0 or COM5")
+    parser.add_argument("--count", type=int, default=500)
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    freqs = [100000000 + (i % 50) * 12345 for i in range(args.count)]
+    with serial.Serial(args.port, args.baud, timeout=2) as ser:
+        ser.reset_input_buffer()
+        text = bench_text(ser, freqs)
+        time.sleep(0.2)
+        ser.reset_input_buffer()
+        binary = bench_binary(ser, freqs)
+    print("text:   %8.1f commands/s" % text)
+    print("binary: %8.1f commands/s (x%.1f)" % (binary, binary / text))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,80 @@
+#!/usr/bin/python3
+#
+#  wave_upload.py
+#  
+#  Author:  Martin Timms
+#  Date:    14th July 2023.
+#  Contributors:
+#  Version: 1.0
+#
+#  Released into the public domain.
+#  
+#  License: MIT License
+#
+#  Description: Uploads a custom LFO modulation waveform to the signal generator with the CU command.
+#  The waveform is either generated (gaussian, chirp) or read from a text file with one sample
+#  (-32768 to 32767) per line, then optionally started with C<depth>.
+#
+
+import argparse
+import math
+import struct
+import time
+
+import serial
+
+MAX_SAMPLES = 1024
+
+
+def gaussian(n, width=0.15):
+    return [math.exp(-0.5 * ((i / n - 0.5) / width) ** 2) * 2.0 - 1.0 for i in range(n)]
+
+
+def chirp(n, cycles=8.0):
+    # sine with a linearly rising rate, cycles over the whole table
+    return [math.sin(math.pi * cycles * (i / n) ** 2) for i in range(n)]
+
+
+def to_samples(values):
+    return [max(-32768, min(32767, int(round(v * 32767)))) for v in values]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Upload a custom LFO waveform")
+    parser.add_argument("port", help="serial port, e.g. /dev/ttyACM0 or COM5")
+    parser.add_argument("shape", help="gaussian, chirp or a file of samples")
+    parser.add_argument("--samples", type=int, default=MAX_SAMPLES, help="generated table length")
+    parser.add_argument("--depth", type=int, default=0, help="start the modulation with C<depth> Hz")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    if args.shape == "gaussian":
+        samples = to_samples(gaussian(args.samples))
+    elif args.shape == "chirp":
+        samples = to_samples(chirp(args.samples))
+    else:
+        with open(args.shape) as f:
+            samples = [int(line) for line in f if line.strip()]
+    if not 2 <= len(samples) <= MAX_SAMPLES:
+        raise SystemExit("waveform must have 2-%d samples" % MAX_SAMPLES)
+
+    with serial.Serial(args.port, args.baud, timeout=2) as ser:
+        ser.reset_input_buffer()
+        ser.write(b"CU\n")
+        while True:
+            line = ser.readline()
+            if not line:
+                raise SystemExit("no response to CU")
+            if b"Send waveform block" in line:
+                break
+        ser.write(struct.pack("<H%dh" % len(samples), len(samples), *samples))
+        print(ser.readline().decode(errors="replace").strip())
+        if args.depth:
+            time.sleep(0.05)
+            ser.write(b"C%d\n" % args.depth)
+            ser.readline()  # echo
+            print(ser.readline().decode(errors="replace").strip())
+
+
+if __name__ == "__main__":
+    main()
@@ -36,7 +36,8 @@
 
    @section dependencies Dependencies
 
-   This library uses the BigNumber library (included) from Nick Gammon
+   The PLL values are calculated with 64 bit integer arithmetic, no external
+   libraries are needed for the frequency calculations.
 
    @section author Author
 
@@ -53,15 +54,24 @@
 */
 
 #include "adf4351.h"
+#include "adf4351_fields.h"
 #include "brd_ltdz_stm32f103cb.h"
 #include "BitBangedSPI.h"
+#include "fast_spi.h"
+#include "dma_spi.h"
+#include "profiler.h"
 
 //uint32_t steps[] = { 10 , 100, 1000, 5000, 10000, 50000, 100000 , 500000, 1000000 }; ///< Array of Allowed Step Values (Hz)
 //uint32_t steps[] = { 7 , 97, 997, 4999, 9973, 49999, 99991 , 500000, 1000000 }; ///< Array of Allowed Step Values (Hz)
-uint16_t freq_step_count = 16;
 uint32_t steps[] = { 1, 5, 8, 10, 20, 50, 100, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 500000 }; ///< Array of Allowed Step Values (Hz)
 
+#if defined(USE_DMA_SPI)
+dmaSPI spi1=dmaSPI((uint32_t)PIN_MOSI, (uint32_t)PIN_SCK, (uint32_t)PIN_SS);
+#elif defined(USE_FAST_SPI)
+fastSPI spi1=fastSPI((uint32_t)PIN_MOSI, (uint32_t)PIN_SCK, (uint32_t)PIN_SS);
+#else
 bitBangedSPI spi1=bitBangedSPI((uint32_t)PIN_MOSI, (uint32_t)PIN_MISO, (uint32_t)PIN_SCK, 1);
+#endif
 
 /*!
    single register constructor
@@ -105,6 +115,7 @@ ADF4351::ADF4351(byte pin, uint8_t mode, unsigned long  speed, BitOrder order )
   reffreq = REF_FREQ_DEFAULT ;
   enabled = false ;
   cfreq = 0 ;
+  ferr_mHz = 0 ;
   ChanStep = steps[0] ;
   RD2refdouble = 0 ;
   RCounter = 25 ;
@@ -113,6 +124,16 @@ ADF4351::ADF4351(byte pin, uint8_t mode, unsigned long  speed, BitOrder order )
   ClkDiv = 150 ;
   Prescaler = 0 ;
   pwrlevel = 0 ;
+  pfdValid = false ;
+  planCacheCount = 0 ;
+  planCacheClock = 0 ;
+  planCacheHits = 0 ;
+  planCacheMisses = 0 ;
+  fracRetunes = 0 ;
+  fracReady = false ;
+  forceWrite = 0x3F ;
+  lastWriteMask = 0 ;
+  onWriteComplete = NULL ;
   SPIspeed=speed;
   SPImode=mode;
   SPIorder=order;
@@ -125,100 +146,138 @@ void ADF4351::init()
   pinMode(PIN_CE, OUTPUT) ;
   pinMode(PIN_LD, INPUT) ; 
   spi1.begin(); 
+  forceWrite = 0x3F ; // device state unknown until every register is written
 } ;
 
-
-int  ADF4351::setf(uint32_t freq, uint16_t phase, uint32_t chan_steps)
+/*!
+   refreshes the cached phase detector frequency when the reference or
+   R counter settings have changed since the last calculation.
+   PFDmHz holds PFDFreq rounded to 3 decimal places, matching the value the
+   earlier BigNumber based calculation parsed from the dtostrf() string.
+*/
+void ADF4351::updatePFD()
 {
-  ChanStep = steps[chan_steps];
-  //  calculate settings from freq
-  if ( freq > ADF_FREQ_MAX ) return 1 ;
+  if ( pfdValid && pfdRef == reffreq && pfdRCounter == RCounter &&
+       pfdRefDouble == RD2refdouble && pfdRdiv2 == RD1Rdiv2 ) return ;
 
-  if ( freq < ADF_FREQ_MIN ) return 1 ;
+  PFDFreq = (float) reffreq  * ( (float) ( 1.0 + RD2refdouble) / (float) (RCounter * (1.0 + RD1Rdiv2)));  // find the loop freq
+  PFDmHz = (uint64_t) llrint( (double) PFDFreq * 1000.0 ) ;
+  pfdRef = reffreq ;
+  pfdRCounter = RCounter ;
+  pfdRefDouble = RD2refdouble ;
+  pfdRdiv2 = RD1Rdiv2 ;
+  pfdValid = true ;
+  planCacheCount = 0 ; // cached plans were solved for the old PFD
+  fracReady = false ; // the registers were encoded for the old PFD
+}
 
-  int localosc_ratio =   2200000000UL / freq ;
-  outdiv = 1 ;
-  int RfDivSel = 0 ;
+/*!
+   selects the output divider that keeps the VCO above 2.2 GHz
+   and the prescaler required for the resulting VCO frequency.
+   @return RfDivSel, the output divider is 1 << RfDivSel
+*/
+uint8_t ADF4351::selectDivider(uint64_t freq, uint8_t &prescaler)
+{
+  uint32_t localosc_ratio =   2200000000UL / freq ;
+  uint32_t div = 1 ;
+  uint8_t divsel = 0 ;
 
   // select the output divider
-  while (  outdiv <=  localosc_ratio   && outdiv <= 64 ) {
-    outdiv *= 2 ;
-    RfDivSel++  ;
+  while (  div <=  localosc_ratio   && div <= 64 ) {
+    div *= 2 ;
+    divsel++  ;
   }
 
-  if ( freq > 3600000000UL/outdiv )
-    Prescaler = 1 ;
+  if ( freq > 3600000000UL/div )
+    prescaler = 1 ;
   else
-    Prescaler = 0 ;
+    prescaler = 0 ;
 
-  PFDFreq = (float) reffreq  * ( (float) ( 1.0 + RD2refdouble) / (float) (RCounter * (1.0 + RD1Rdiv2)));  // find the loop freq
-  BigNumber::begin(10) ;
-  char tmpstr[20] ;
-  // kludge - BigNumber doesn't like leading spaces
-  // so you need to make sure the string passed doesnt
-  // have leading spaces.
-  int cntdigits = 0 ;
-  uint32_t num = (uint32_t) ( PFDFreq / 10000 ) ;
-
-  while ( num != 0 )  {
-    cntdigits++ ;
-    num /= 10 ;
-  }
-
-  dtostrf(PFDFreq, cntdigits + 8 , 3, tmpstr) ;
-  // end of kludge
-  BigNumber BN_PFDFreq = BigNumber(tmpstr) ;
-  BigNumber BN_N = ( BigNumber(freq) * BigNumber(outdiv) ) / BN_PFDFreq ;
-  N_Int =  (uint16_t) ( (uint32_t)  BN_N ) ;
-  BigNumber BN_Mod = BN_PFDFreq / BigNumber(ChanStep) ;
-  Mod = BN_Mod ;
-  BN_Mod = BigNumber(Mod) ;
-  BigNumber BN_Frac = ((BN_N - BigNumber(N_Int)) * BN_Mod)  + BigNumber("0.5")  ;
-  Frac = (int) ( (uint32_t) BN_Frac);
-  BN_N = BigNumber(N_Int) ;
+  return divsel ;
+}
+
+/*!
+   calculates outdiv, RfDivSel, Prescaler, N_Int, Frac, Mod and cfreq for freq
+   using the current ChanStep.
+
+   All arithmetic is 64 bit integer. Intermediate values are truncated to 10
+   decimal places exactly as BigNumber::begin(10) did, so the register values
+   are identical to the previous BigNumber implementation:
+
+   N    = trunc10( freq * outdiv / PFD )
+   Mod  = floor( PFD / ChanStep )
+   Frac = floor( frac(N) * Mod + 0.5 )
+*/
+void ADF4351::calcPLL(uint64_t freq)
+{
+  RfDivSel = selectDivider(freq, Prescaler) ;
+  outdiv = 1 << RfDivSel ;
+
+  updatePFD() ;
+  const uint64_t pfd = PFDmHz ;
+  const uint64_t E5 = 100000ULL ;
+  const uint64_t E10 = 10000000000ULL ;
+
+  // N = vco / PFD, all in mHz
+  uint64_t vco = (uint64_t) freq * (uint64_t) outdiv * 1000ULL ;
+  N_Int = (uint16_t) (uint32_t) ( vco / pfd ) ;
+  uint64_t rem = vco % pfd ;
+  // fractional part of N to 10 decimal places, long division in two 10^5 digits
+  uint64_t nfrac = ( rem * E5 ) / pfd ;
+  rem = ( rem * E5 ) % pfd ;
+  nfrac = nfrac * E5 + ( rem * E5 ) / pfd ;
+
+  Mod = (uint32_t) ( pfd / ( (uint64_t) ChanStep * 1000ULL ) ) ;
+  Frac = (int) (uint32_t) ( ( nfrac * Mod + E10 / 2 ) / E10 ) ;
 
   if ( Frac != 0  ) {
     uint32_t gcd = gcd_iter(Frac, Mod) ;
 
     if ( gcd > 1 ) {
       Frac /= gcd ;
-      BN_Frac = BigNumber(Frac) ;
       Mod /= gcd ;
-      BN_Mod = BigNumber(Mod) ;
     }
   }
 
-  BigNumber BN_cfreq ;
+  // cfreq = trunc( PFD * ( N_Int + trunc10(Frac / Mod) ) / outdiv )
+  // split so that every partial product stays within 64 bits
+  uint64_t q = ( Frac == 0 ) ? 0 : ( (uint64_t) Frac * E10 ) / Mod ;
+  uint64_t d = 1000ULL * (uint64_t) outdiv ;
+  uint64_t pn = pfd * N_Int ;
+  uint64_t pqh = pfd * ( q / E5 ) ;
+  uint64_t acc = ( pn % d ) * E10 + ( pqh % ( d * E5 ) ) * E5 + pfd * ( q % E5 ) ;
+  cfreq = (uint64_t) ( pn / d + pqh / ( d * E5 ) + acc / ( d * E10 ) ) ;
+}
 
-  if ( Frac == 0 ) {
-    BN_cfreq = ( BN_PFDFreq  * BN_N) / BigNumber(outdiv) ;
 
-  } else {
-    BN_cfreq = ( BN_PFDFreq * ( BN_N + ( BN_Frac /  BN_Mod) ) ) / BigNumber(outdiv) ;
-  }
+int  ADF4351::setf(uint64_t freq, uint16_t phase, uint32_t chan_steps)
+{
+  ChanStep = steps[chan_steps];
+  //  calculate settings from freq
+  if ( freq > ADF_FREQ_MAX ) return 1 ;
 
-  cfreq = BN_cfreq ;
+  if ( freq < ADF_FREQ_MIN ) return 1 ;
 
-  if ( cfreq != freq ) Serial.println(F("output freq diff than requested")) ;
+  calcPLL(freq) ;
 
-  BigNumber::finish() ;
+  if ( cfreq != freq ) Serial_println(F("output freq diff than requested")) ;
 
   if ( Mod < 2 || Mod > 4095) {
-    Serial.println(F("Mod out of range")) ;
+    Serial_println(F("Mod out of range")) ;
     return 1 ;
   }
 
   if ( (uint32_t) Frac > (Mod - 1) ) {
-    Serial.println(F("Frac out of range")) ;
+    Serial_println(F("Frac out of range")) ;
     return 1 ;
   }
 
   if ( Prescaler == 0 && ( N_Int < 23  || N_Int > 65535)) {
-    Serial.println(F("N_Int out of range")) ;
+    Serial_println(F("N_Int out of range")) ;
     return 1;
 
   } else if ( Prescaler == 1 && ( N_Int < 75 || N_Int > 65535 )) {
-    Serial.println(F("N_Int out of range")) ;
+    Serial_println(F("N_Int out of range")) ;
     return 1;
   }
 
@@ -226,367 +285,565 @@ int  ADF4351::setf(uint32_t freq, uint16_t phase, uint32_t chan_steps)
   // R0
   R[0].set(0UL) ;
   // (0,3,0) control bits
-  R[0].setbf(3, 12, Frac) ; // fractonal
-  R[0].setbf(15, 16, N_Int) ; // N integer
+  Adf::FracValue::set(R, Frac) ; // fractonal
+  Adf::IntValue::set(R, N_Int) ; // N integer
   // R1
   R[1].set(0UL) ;
-  R[1].setbf(0, 3, 1) ; // control bits
-  R[1].setbf(3, 12, Mod) ; // Mod
-  R[1].setbf(15, 12, phase); // phase
-  R[1].setbf(27, 1, Prescaler); //  prescaler
+  Adf::Control<1>::set(R) ; // control bits
+  Adf::ModValue::set(R, Mod) ; // Mod
+  Adf::PhaseValue::set(R, phase) ; // phase
+  Adf::Prescaler::set(R, Prescaler) ; //  prescaler
   // (28,1,0) phase adjust
   // R2
   R[2].set(0UL) ;
-  R[2].setbf(0, 3, 2) ; // control bits
+  Adf::Control<2>::set(R) ; // control bits
   // (3,1,0) counter reset
   // (4,1,0) cp3 state
   // (5,1,0) power down
-  R[2].setbf(6, 1, 1) ; // pd polarity
+  Adf::PDPolarity::set<1>(R) ; // pd polarity
 
   if ( Frac == 0 )  {
-    R[2].setbf(7, 1, 1) ; // LDP, int-n mode
-    R[2].setbf(8, 1, 1) ; // ldf, int-n mode
+    Adf::LDP::set<1>(R) ; // LDP, int-n mode
+    Adf::LDF::set<1>(R) ; // ldf, int-n mode
 
   } else {
-    R[2].setbf(7, 1, 0) ; // LDP, frac-n mode
-    R[2].setbf(8, 1, 0) ; // ldf ,frac-n mode
+    Adf::LDP::set<0>(R) ; // LDP, frac-n mode
+    Adf::LDF::set<0>(R) ; // ldf ,frac-n mode
   }
 
-  R[2].setbf(9, 4, 7) ; // charge pump
+  Adf::ChargePump::set<7>(R) ; // charge pump
   // (13,1,0) dbl buf
-  R[2].setbf(14, 10, RCounter) ; //  r counter
-  R[2].setbf(24, 1, RD1Rdiv2)  ; // RD1_RDiv2
-  R[2].setbf(25, 1, RD2refdouble)  ; // RD2refdouble
-  // R[2].setbf(26,3,0) ; //  muxout, not used
-  R[2].setbf(26,3,6) ; //  muxout, digital lock detect
-  //R[2].setbf(26,3,1) ; //  muxout, VDD
+  Adf::RCounter::set(R, RCounter) ; //  r counter
+  Adf::RDiv2::set(R, RD1Rdiv2) ; // RD1_RDiv2
+  Adf::RefDoubler::set(R, RD2refdouble) ; // RD2refdouble
+  // Adf::MuxOut::set<0>(R) ; //  muxout, not used
+  Adf::MuxOut::set<6>(R) ; //  muxout, digital lock detect
+  //Adf::MuxOut::set<1>(R) ; //  muxout, VDD
   // (29,2,0) low noise and spurs mode
   // R3
   R[3].set(0UL) ;
-  R[3].setbf(0, 3, 3) ; // control bits
-  R[3].setbf(3, 12, ClkDiv) ; // clock divider
+  Adf::Control<3>::set(R) ; // control bits
+  Adf::ClkDiv::set(R, ClkDiv) ; // clock divider
 
   // (15,2,0) clk div mode
   // (17,1,0) reserved
   // (18,1,0) CSR
-  //R[3].setbf(18,1,1); //Cycle slip reduction CSR
+  //Adf::CSR::set<1>(R) ; //Cycle slip reduction CSR
   // (19,2,0) reserved
   if ( Frac == 0 )  {
-    R[3].setbf(21, 1, 1); //  charge cancel, reduces pfd spurs
-    R[3].setbf(22, 1, 1); //  ABP, int-n
+    Adf::ChargeCancel::set<1>(R) ; //  charge cancel, reduces pfd spurs
+    Adf::ABP::set<1>(R) ; //  ABP, int-n
 
   } else  {
-    R[3].setbf(21, 1, 0) ; //  charge cancel
-    R[3].setbf(22, 1, 0); //  ABP, frac-n
+    Adf::ChargeCancel::set<0>(R) ; //  charge cancel
+    Adf::ABP::set<0>(R) ; //  ABP, frac-n
   }
 
-  R[3].setbf(23, 1, 1) ; // Band Select Clock Mode
+  Adf::BandSelClkMode::set<1>(R) ; // Band Select Clock Mode
   // (24,8,0) reserved
   // R4
   R[4].set(0UL) ;
-  R[4].setbf(0, 3, 4) ; // control bits
-  R[4].setbf(3, 2, pwrlevel) ; // output power 0-3 (-4dbM to 5dbM, 3db steps)
-  R[4].setbf(5, 1, 1) ; // rf output enable
-  //R[4].setbf(5, 1, 0) ; // rf output disable
+  Adf::Control<4>::set(R) ; // control bits
+  Adf::OutputPower::set(R, pwrlevel) ; // output power 0-3 (-4dbM to 5dbM, 3db steps)
+  Adf::RFOutEnable::set<1>(R) ; // rf output enable
+  //Adf::RFOutEnable::set<0>(R) ; // rf output disable
   // (6,2,0) aux output power
   // (8,1,0) aux output enable
   // (9,1,0) aux output select
   // (10,1,0) mtld
-  R[4].setbf(11, 1, 0) ; // vco power up
+  Adf::VCOPowerDown::set<0>(R) ; // vco power up
   // (11,1,1) vco power down
-  R[4].setbf(12, 8, BandSelClock) ; // band select clock divider
-  R[4].setbf(20, 3, RfDivSel) ; // rf divider select
-  R[4].setbf(23, 1, 1) ; // feedback select
+  Adf::BandSelClkDiv::set(R, BandSelClock) ; // band select clock divider
+  Adf::RFDivSel::set(R, RfDivSel) ; // rf divider select
+  Adf::FeedbackSelect::set<1>(R) ; // feedback select
   // (24,8,0) reserved
   // R5
   R[5].set(0UL) ;
-  R[5].setbf(0, 3, 5) ; // control bits
+  Adf::Control<5>::set(R) ; // control bits
   // (3,16,0) reserved
-  R[5].setbf(19, 2, 3) ; // Reserved field,set to 11
+  Adf::Reserved5::set<3>(R) ; // Reserved field,set to 11
   // (21,1,0) reserved
-  R[5].setbf(22, 2, 1) ; // LD Pin Mode Digital lock detect
-  //R[5].setbf(22, 2, 3) ; // LD Pin Mode On
-  //R[5].setbf(22, 2, 0) ; // LD Pin Mode Off
+  Adf::LDPinMode::set<1>(R) ; // LD Pin Mode Digital lock detect
+  //Adf::LDPinMode::set<3>(R) ; // LD Pin Mode On
+  //Adf::LDPinMode::set<0>(R) ; // LD Pin Mode Off
   // (24,8,0) reserved
   return writeRegisters();  
 }
 
 
-//Gretest common divisor
-uint32_t gcd(uint32_t a, uint32_t b) {
-    // Ensure a is always greater than or equal to b
-    if (b > a) {
-        uint32_t temp = a;
-        a = b;
-        b = temp;
-    }
-    while (b != 0 && a > 1 ) {
-        uint32_t remainder = a % b;
-        a = b;
-        b = remainder;
-    }
-    return a;
-}
-
 int ADF4351::lock_freq(bool debug){
-  R[3].setbf(0, 3, 3); // control bits
-  R[3].setbf(18, 1, 1); // Enable cycle slip reduction
-  return writeRegisters(debug);  
+  Adf::Control<3>::set(R) ; // control bits
+  Adf::CSR::set<1>(R) ; // Enable cycle slip reduction
+  return writeChanged(debug);  
 }
 
-int  ADF4351::optimise_f_only(uint32_t freq, bool debug,bool log_info, bool gcd_method)
+int  ADF4351::optimise_f_only(uint64_t freq, bool debug, bool log_info)
 {
-  bool freq_set=false;
-  if(gcd_method==true){
-    uint32_t s=gcd(freq,reffreq);
-    if(setf_only(freq,s,debug)==0){
+  if ( retuneFrac(freq, debug) != 0 ) {
+    PLLPlan p ;
+    uint32_t t = Profiler::start() ;
+    if ( planCached(freq, p) != 0 ) {
+      profiler.end(PROF_PLAN_FAIL, t) ;
       if(log_info==true){
-        Serial.print("Common divisor: ");
-        Serial.println(s);
-        Serial.print("Step Frequency set to: ");
-        Serial.println(freq);
+        Serial_println("Frequency not set");
       }
-      freq_set=true;
+      return 1 ;
     }
+    profiler.end(PROF_PLAN, t) ;
+    setPlan(p, debug) ;
   }
-  if(freq_set==false){
-    //Check for frequencies which are multiplies of step sizes
-    for(int s=(freq_step_count-1); s>=0; s--){
-      if (freq % steps[s]==0){
-        if(setf_only(freq,s,debug)==0){
-          if(log_info==true){
-            Serial.print("Step Frequency set to: ");
-            Serial.println(freq);
-          }
-          freq_set=true;
-          break;
-        }
-      }
-    }
-  }
-  if(freq_set==false){
-    for(int s=0; s<freq_step_count; s++){
-      if(setf_only(freq,s,debug)==0){
-        if(log_info==true){
-          Serial.print("Step Frequency set to: ");
-          Serial.println(freq);
-        }
-        freq_set=true;
-        break;
-      }
+  if(log_info==true){
+    Serial_print("Step Frequency set to: ");
+    Serial_println(freq);
+    if ( ferr_mHz != 0 ) {
+      Serial_print("Frequency error (mHz): ");
+      Serial_println(ferr_mHz);
     }
   }
-  if(freq_set==false && log_info==true){
-      Serial.println("Frequency not set");
-  }
   return 0;
 }
 
-int  ADF4351::setf_only(uint32_t freq, uint32_t chan_steps, bool debug)
+/*!
+   finds the FRAC/MOD pair closest to the fractional part of N in one pass.
+
+   The fraction rem/PFD is expanded as a continued fraction. The last
+   convergent and the best semiconvergent with a denominator up to
+   ADF_MOD_MAX are compared, which gives the closest rational of all
+   those with MOD <= ADF_MOD_MAX, and the exact ratio whenever one exists.
+*/
+int  ADF4351::plan(uint64_t freq, PLLPlan &p)
 {
-  ChanStep = steps[chan_steps];
-  //  calculate settings from freq
   if ( freq > ADF_FREQ_MAX ) return 1 ;
 
   if ( freq < ADF_FREQ_MIN ) return 1 ;
 
-  int localosc_ratio =   2200000000UL / freq ;
-  outdiv = 1 ;
-  int RfDivSel = 0 ;
+  uint8_t prescaler ;
+  uint8_t divsel = selectDivider(freq, prescaler) ;
+  updatePFD() ;
+  return solvePlan(freq, divsel, prescaler, 0, p) ;
+}
 
-  // select the output divider
-  while (  outdiv <=  localosc_ratio   && outdiv <= 64 ) {
-    outdiv *= 2 ;
-    RfDivSel++  ;
+/*!
+   solves freq for a given output divider and prescaler. A non zero keepMod
+   is used as it is when it gives freq exactly, which saves the continued
+   fraction and leaves R1 unchanged.
+*/
+int ADF4351::solvePlan(uint64_t freq, uint8_t divsel, uint8_t prescaler, uint16_t keepMod, PLLPlan &p)
+{
+  p.freq = freq ;
+  p.RfDivSel = divsel ;
+  p.Prescaler = prescaler ;
+  p.FracN = 0 ;
+  uint32_t div = 1UL << divsel ;
+
+  const uint64_t pfd = PFDmHz ;
+  uint64_t vco = (uint64_t) freq * div * 1000ULL ;
+  uint64_t n = vco / pfd ;
+  uint64_t rem = vco % pfd ;
+  uint64_t frac, mod ;
+
+  if ( keepMod != 0 && ( rem * keepMod ) % pfd == 0 ) {
+    frac = rem * keepMod / pfd ;
+    mod = keepMod ;
+  } else {
+    // continued fraction expansion of rem / pfd, convergents h1 / k1
+    uint64_t h0 = 0, k0 = 1, h1 = 1, k1 = 0 ;
+    uint64_t num = rem, den = pfd ;
+    while ( den != 0 ) {
+      uint64_t t = num / den ;
+      uint64_t k2 = t * k1 + k0 ;
+      if ( k2 > ADF_MOD_MAX ) {
+        // largest semiconvergent within the MOD limit
+        t = ( ADF_MOD_MAX - k0 ) / k1 ;
+        uint64_t hs = t * h1 + h0, ks = t * k1 + k0 ;
+        // use it if it is closer than the last convergent
+        uint64_t e1 = ( rem * k1 > h1 * pfd ) ? rem * k1 - h1 * pfd : h1 * pfd - rem * k1 ;
+        uint64_t es = ( rem * ks > hs * pfd ) ? rem * ks - hs * pfd : hs * pfd - rem * ks ;
+        if ( es * k1 < e1 * ks ) {
+          h1 = hs ;
+          k1 = ks ;
+        }
+        break ;
+      }
+      uint64_t h2 = t * h1 + h0 ;
+      h0 = h1 ; k0 = k1 ;
+      h1 = h2 ; k1 = k2 ;
+      uint64_t r = num - t * den ;
+      num = den ;
+      den = r ;
+    }
+    frac = h1 ;
+    mod = k1 ;
+  }
+  if ( frac == mod ) {
+    // rounded up to the next integer
+    n++ ;
+    frac = 0 ;
   }
+  if ( frac == 0 ) mod = 2 ;
 
-  if ( freq > 3600000000UL/outdiv )
-    Prescaler = 1 ;
-  else
-    Prescaler = 0 ;
+  if ( p.Prescaler == 0 && ( n < 23 || n > 65535 ) ) return 1 ;
 
-  PFDFreq = (float) reffreq  * ( (float) ( 1.0 + RD2refdouble) / (float) (RCounter * (1.0 + RD1Rdiv2)));  // find the loop freq
-  BigNumber::begin(10) ;
-  char tmpstr[20] ;
-  // kludge - BigNumber doesn't like leading spaces
-  // so you need to make sure the string passed doesnt
-  // have leading spaces.
-  int cntdigits = 0 ;
-  uint32_t num = (uint32_t) ( PFDFreq / 10000 ) ;
-
-  while ( num != 0 )  {
-    cntdigits++ ;
-    num /= 10 ;
-  }
-
-  dtostrf(PFDFreq, cntdigits + 8 , 3, tmpstr) ;
-  // end of kludge
-  BigNumber BN_PFDFreq = BigNumber(tmpstr) ;
-  BigNumber BN_N = ( BigNumber(freq) * BigNumber(outdiv) ) / BN_PFDFreq ;
-  N_Int =  (uint16_t) ( (uint32_t)  BN_N ) ;
-  BigNumber BN_Mod = BN_PFDFreq / BigNumber(ChanStep) ;
-  Mod = BN_Mod ;
-  BN_Mod = BigNumber(Mod) ;
-  BigNumber BN_Frac = ((BN_N - BigNumber(N_Int)) * BN_Mod)  + BigNumber("0.5")  ;
-  Frac = (int) ( (uint32_t) BN_Frac);
-  BN_N = BigNumber(N_Int) ;
+  if ( p.Prescaler == 1 && ( n < 75 || n > 65535 ) ) return 1 ;
 
-  if ( Frac != 0  ) {
-    uint32_t gcd = gcd_iter(Frac, Mod) ;
+  p.N_Int = (uint16_t) n ;
+  p.Frac = (uint16_t) frac ;
+  p.Mod = (uint16_t) mod ;
 
-    if ( gcd > 1 ) {
-      Frac /= gcd ;
-      BN_Frac = BigNumber(Frac) ;
-      Mod /= gcd ;
-      BN_Mod = BigNumber(Mod) ;
+  // error = PFD * ( Frac / Mod - rem / PFD ) / outdiv
+  int64_t err = (int64_t) ( pfd * frac ) - (int64_t) ( rem * mod ) ;
+  if ( frac == 0 && n != vco / pfd ) err = (int64_t) ( pfd - rem ) * (int64_t) mod ;
+  p.ferr_mHz = (int32_t) ( err / (int64_t) ( mod * div ) ) ;
+  int64_t gen = (int64_t) freq * 1000LL * (int64_t) ( mod * div ) + err ;
+  p.cfreq = (uint64_t) ( gen / (int64_t) ( 1000ULL * mod * div ) ) ;
+  return 0 ;
+}
+
+/*!
+   small step fast path for optimise_f_only(). The output divider, prescaler and
+   MOD are read back from the registers, so it also follows RegTable playback.
+   It is only taken when the current MOD hits freq exactly, then only INT/FRAC
+   (R0) changes. Any other step is left to planCached().
+*/
+int ADF4351::retuneFrac(uint64_t freq, bool debug)
+{
+  if ( freq > ADF_FREQ_MAX || freq < ADF_FREQ_MIN || forceWrite != 0 ) return 1 ;
+
+  updatePFD() ;
+  if ( !fracReady ) return 1 ; // no full plan written for the current reference
+
+  uint8_t prescaler ;
+  uint8_t divsel = selectDivider(freq, prescaler) ;
+  if ( divsel != Adf::RFDivSel::get(R) || prescaler != Adf::Prescaler::get(R) ) return 1 ;
+
+  // int-N mode (FRAC 0) also changes R2 and R3
+  if ( Adf::FracValue::get(R) == 0 ) return 1 ;
+
+  // a new MOD needs the continued fraction, which the plan cache may already hold
+  uint32_t t = Profiler::start() ;
+  uint16_t mod = Adf::ModValue::get(R) ;
+  uint64_t rem = ( (uint64_t) freq * ( 1UL << divsel ) * 1000ULL ) % PFDmHz ;
+  if ( ( rem * mod ) % PFDmHz != 0 ) return 1 ;
+
+  PLLPlan p ;
+  if ( solvePlan(freq, divsel, prescaler, mod, p) != 0 || p.Frac == 0 ) return 1 ;
+
+  RfDivSel = divsel ;
+  outdiv = 1 << divsel ;
+  Prescaler = prescaler ;
+  N_Int = p.N_Int ;
+  Frac = p.Frac ;
+  Mod = p.Mod ;
+  cfreq = p.cfreq ;
+  ferr_mHz = p.ferr_mHz ;
+  Adf::FracValue::set(R, p.Frac) ;
+  Adf::IntValue::set(R, p.N_Int) ;
+  Adf::ModValue::set(R, p.Mod) ;
+  Adf::CSR::set<0>(R) ; // as encodePlan(), lock_freq() enables it once settled
+  fracRetunes++ ;
+  profiler.end(PROF_FRAC, t) ;
+  return writeChanged(debug) ;
+}
+
+/*!
+   looks freq up in the plan cache, solving and adding it on a miss.
+   When the cache is full the least recently used entry is replaced.
+*/
+int ADF4351::planCached(uint64_t freq, PLLPlan &p)
+{
+  updatePFD() ;
+  planCacheClock++ ;
+  uint8_t lru = 0 ;
+  for (uint8_t i = 0 ; i < planCacheCount ; i++) {
+    if ( planCache[i].freq == freq ) {
+      planCacheUse[i] = planCacheClock ;
+      planCacheHits++ ;
+      p = planCache[i] ;
+      return 0 ;
     }
+    if ( planCacheUse[i] < planCacheUse[lru] ) lru = i ;
   }
+  planCacheMisses++ ;
+  if ( plan(freq, p) != 0 ) return 1 ;
 
-  BigNumber BN_cfreq ;
+  if ( planCacheCount < ADF_PLAN_CACHE_SIZE ) lru = planCacheCount++ ;
+  planCache[lru] = p ;
+  planCacheUse[lru] = planCacheClock ;
+  return 0 ;
+}
 
-  if ( Frac == 0 ) {
-    BN_cfreq = ( BN_PFDFreq  * BN_N) / BigNumber(outdiv) ;
+int ADF4351::setPlan(const PLLPlan &p, bool debug)
+{
+  N_Int = p.N_Int ;
+  Frac = p.Frac ;
+  Mod = p.Mod ;
+  RfDivSel = p.RfDivSel ;
+  outdiv = 1 << p.RfDivSel ;
+  Prescaler = p.Prescaler ;
+  cfreq = p.cfreq ;
+  ferr_mHz = p.ferr_mHz ;
+  return setPLLRegisters(debug) ;
+}
 
-  } else {
-    BN_cfreq = ( BN_PFDFreq * ( BN_N + ( BN_Frac /  BN_Mod) ) ) / BigNumber(outdiv) ;
-  }
+int  ADF4351::setf_only(uint64_t freq, uint32_t chan_steps, bool debug)
+{
+  ChanStep = steps[chan_steps];
+  //  calculate settings from freq
+  if ( freq > ADF_FREQ_MAX ) return 1 ;
+
+  if ( freq < ADF_FREQ_MIN ) return 1 ;
 
-  cfreq = BN_cfreq ;
+  uint32_t t = Profiler::start() ;
+  calcPLL(freq) ;
+  uint32_t cycles = DWT->CYCCNT - t ;
 
   if ( cfreq != freq ) {
     if(debug){
-      Serial.println(F("output freq diff than requested")) ;
+      Serial_println(F("output freq diff than requested")) ;
     }
   }
 
-  BigNumber::finish() ;
-
   if ( Mod < 2 || Mod > 4095) {
     if(debug){
-      Serial.print(F("Mod out of range: ")) ;
-      Serial.println(Mod) ;
+      Serial_print(F("Mod out of range: ")) ;
+      Serial_println(Mod) ;
     }
+    profiler.record(PROF_PLAN_FAIL, cycles) ;
     return 1 ;
   }
 
   if ( (uint32_t) Frac > (Mod - 1) ) {
     if(debug){
-        Serial.println(F("Frac out of range")) ;
+        Serial_println(F("Frac out of range")) ;
     }
+    profiler.record(PROF_PLAN_FAIL, cycles) ;
     return 1 ;
   }
 
   if ( Prescaler == 0 && ( N_Int < 23  || N_Int > 65535)) {
     if(debug){
-      Serial.println(F("N_Int out of range")) ;
+      Serial_println(F("N_Int out of range")) ;
     }
+    profiler.record(PROF_PLAN_FAIL, cycles) ;
     return 1;
 
   } else if ( Prescaler == 1 && ( N_Int < 75 || N_Int > 65535 )) {
     if(debug){
-      Serial.println(F("N_Int out of range")) ;
+      Serial_println(F("N_Int out of range")) ;
     }
+    profiler.record(PROF_PLAN_FAIL, cycles) ;
     return 1;
   }
 
+  profiler.record(PROF_PLAN, cycles) ;
+  ferr_mHz = 0 ;
+  return setPLLRegisters(debug) ;
+}
+
+int ADF4351::setPLLRegisters(bool debug)
+{
+  PLLPlan p ;
+  p.N_Int = N_Int ;
+  p.Frac = Frac ;
+  p.Mod = Mod ;
+  p.RfDivSel = RfDivSel ;
+  p.Prescaler = Prescaler ;
+  p.FracN = 0 ;
+  uint32_t t = Profiler::start() ;
+  encodePlan(p, R) ;
+  profiler.end(PROF_ENCODE, t) ;
+  fracReady = true ;
+  return writeChanged(debug);  
+}
+
+void ADF4351::syncFromRegisters()
+{
+  // a table may be playing from an interrupt, take R0, R1 and R4 from the same step
+  Reg regs[5] ;
+  uint32_t primask = __get_PRIMASK() ;
+  __disable_irq() ;
+  regs[0] = R[0] ;
+  regs[1] = R[1] ;
+  regs[4] = R[4] ;
+  __set_PRIMASK(primask) ;
+
+  uint16_t n = Adf::IntValue::get(regs) ;
+  uint16_t frac = Adf::FracValue::get(regs) ;
+  uint16_t mod = Adf::ModValue::get(regs) ;
+  uint8_t divsel = Adf::RFDivSel::get(regs) ;
+  if ( n == N_Int && frac == Frac && mod == Mod && divsel == RfDivSel ) return ;
+
+  updatePFD() ;
+  N_Int = n ;
+  Frac = frac ;
+  Mod = mod ;
+  RfDivSel = divsel ;
+  outdiv = 1 << divsel ;
+  Prescaler = Adf::Prescaler::get(regs) ;
+  // as solvePlan(), PFD * ( INT + FRAC / MOD ) / outdiv truncated to Hz
+  uint64_t m = mod != 0 ? mod : 1 ;
+  cfreq = PFDmHz * ( (uint64_t) n * m + frac ) / ( 1000ULL * m * outdiv ) ;
+  ferr_mHz = 0 ;
+}
+
+void ADF4351::encodePlan(const PLLPlan &p, Reg *regs)
+{
   // (0,3,0) control bits
-  R[0].setbf(0, 3, 0) ; // control bits
-  R[0].setbf(3, 12, Frac) ; // fractonal
-  R[0].setbf(15, 16, N_Int) ; // N integer
+  Adf::Control<0>::set(regs) ; // control bits
+  Adf::FracValue::set(regs, p.Frac) ; // fractonal
+  Adf::IntValue::set(regs, p.N_Int) ; // N integer
   // R1
-  R[1].setbf(0, 3, 1) ; // control bits
-  R[1].setbf(3, 12, Mod) ; // Mod
-  R[1].setbf(27, 1, Prescaler); //  prescaler
+  Adf::Control<1>::set(regs) ; // control bits
+  Adf::ModValue::set(regs, p.Mod) ; // Mod
+  Adf::Prescaler::set(regs, p.Prescaler) ; //  prescaler
   // (28,1,0) phase adjust
   // R2
-  R[2].setbf(0, 3, 2) ; // control bits
-  R[2].setbf(6, 1, 1) ; // pd polarity
-  if ( Frac == 0 )  {
-    R[2].setbf(7, 1, 1) ; // LDP, int-n mode
-    R[2].setbf(8, 1, 1) ; // ldf, int-n mode
+  Adf::Control<2>::set(regs) ; // control bits
+  Adf::PDPolarity::set<1>(regs) ; // pd polarity
+  if ( p.Frac == 0 && p.FracN == 0 )  {
+    Adf::LDP::set<1>(regs) ; // LDP, int-n mode
+    Adf::LDF::set<1>(regs) ; // ldf, int-n mode
   } else {
-    R[2].setbf(7, 1, 0) ; // LDP, frac-n mode
-    R[2].setbf(8, 1, 0) ; // ldf ,frac-n mode
+    Adf::LDP::set<0>(regs) ; // LDP, frac-n mode
+    Adf::LDF::set<0>(regs) ; // ldf ,frac-n mode
   }
-  R[2].setbf(9, 4, 7) ; // charge pump
+  Adf::ChargePump::set<7>(regs) ; // charge pump
   // (13,1,0) dbl buf
-  R[2].setbf(14, 10, RCounter) ; //  r counter
-  R[2].setbf(24, 1, RD1Rdiv2)  ; // RD1_RDiv2
-  R[2].setbf(25, 1, RD2refdouble)  ; // RD2refdouble
-  // R[2].setbf(26,3,0) ; //  muxout, not used
-  R[2].setbf(26,3,6) ; //  muxout, digital lock detect
-  //R[2].setbf(26,3,1) ; //  muxout, VDD
+  Adf::RCounter::set(regs, RCounter) ; //  r counter
+  Adf::RDiv2::set(regs, RD1Rdiv2) ; // RD1_RDiv2
+  Adf::RefDoubler::set(regs, RD2refdouble) ; // RD2refdouble
+  // Adf::MuxOut::set<0>(regs) ; //  muxout, not used
+  Adf::MuxOut::set<6>(regs) ; //  muxout, digital lock detect
+  //Adf::MuxOut::set<1>(regs) ; //  muxout, VDD
   // (29,2,0) low noise and spurs mode
   // R3
-  R[3].setbf(0, 3, 3) ; // control bits
-  R[3].setbf(3, 12, ClkDiv) ; // clock divider
+  Adf::Control<3>::set(regs) ; // control bits
+  Adf::ClkDiv::set(regs, ClkDiv) ; // clock divider
 
-  R[3].setbf(18, 1, 0); //disable slip reduction
+  Adf::CSR::set<0>(regs) ; //disable slip reduction
   // (15,2,0) clk div mode
   // (17,1,0) reserved
   // (18,1,0) CSR
   // (19,2,0) reserved
-  if ( Frac == 0 )  {
-    R[3].setbf(21, 1, 1); //  charge cancel, reduces pfd spurs
-    R[3].setbf(22, 1, 1); //  ABP, int-n
+  if ( p.Frac == 0 && p.FracN == 0 )  {
+    Adf::ChargeCancel::set<1>(regs) ; //  charge cancel, reduces pfd spurs
+    Adf::ABP::set<1>(regs) ; //  ABP, int-n
 
   } else  {
-    R[3].setbf(21, 1, 0) ; //  charge cancel
-    R[3].setbf(22, 1, 0); //  ABP, frac-n
+    Adf::ChargeCancel::set<0>(regs) ; //  charge cancel
+    Adf::ABP::set<0>(regs) ; //  ABP, frac-n
   }
 
-  R[3].setbf(23, 1, 1) ; // Band Select Clock Mode
+  Adf::BandSelClkMode::set<1>(regs) ; // Band Select Clock Mode
   // (24,8,0) reserved
   // R4
-  R[4].setbf(0, 3, 4) ; // control bits
-  R[4].setbf(5, 1, 1) ; // rf output enable
-  //R[4].setbf(5, 1, 0) ; // rf output disable
+  Adf::Control<4>::set(regs) ; // control bits
+  Adf::RFOutEnable::set<1>(regs) ; // rf output enable
+  //Adf::RFOutEnable::set<0>(regs) ; // rf output disable
   // (6,2,0) aux output power
   // (8,1,0) aux output enable
   // (9,1,0) aux output select
   // (10,1,0) mtld
-  R[4].setbf(11, 1, 0) ; // vco power up
+  Adf::VCOPowerDown::set<0>(regs) ; // vco power up
   // (11,1,1) vco power down
-  R[4].setbf(12, 8, BandSelClock) ; // band select clock divider
-  R[4].setbf(20, 3, RfDivSel) ; // rf divider select
-  R[4].setbf(23, 1, 1) ; // feedback select
+  Adf::BandSelClkDiv::set(regs, BandSelClock) ; // band select clock divider
+  Adf::RFDivSel::set(regs, p.RfDivSel) ; // rf divider select
+  Adf::FeedbackSelect::set<1>(regs) ; // feedback select
   // (24,8,0) reserved
   // R5
-  R[5].setbf(0, 3, 5) ; // control bits
+  Adf::Control<5>::set(regs) ; // control bits
   // (3,16,0) reserved
-  R[5].setbf(19, 2, 3) ; // Reserved field,set to 11
+  Adf::Reserved5::set<3>(regs) ; // Reserved field,set to 11
   // (21,1,0) reserved
-  R[5].setbf(22, 2, 1) ; // LD Pin Mode Digital lock detect
-  //R[5].setbf(22, 2, 3) ; // LD Pin Mode On
-  //R[5].setbf(22, 2, 0) ; // LD Pin Mode Off
+  Adf::LDPinMode::set<1>(regs) ; // LD Pin Mode Digital lock detect
+  //Adf::LDPinMode::set<3>(regs) ; // LD Pin Mode On
+  //Adf::LDPinMode::set<0>(regs) ; // LD Pin Mode Off
   // (24,8,0) reserved
-  return writeRegisters(debug);  
 }
 
-int ADF4351::writeRegisters(bool debug)
+void ADF4351::writeMask(uint8_t mask)
 {
   int i;
-  if(debug){
-    Serial.println("writing to ADF") ;
+  uint32_t t = Profiler::start() ;
+  lastWriteMask = mask ;
+#ifdef USE_DMA_SPI
+  // queue the words for the DMA writer, R5 first and R0 last
+  uint32_t words[6] ;
+  uint8_t count = 0 ;
+  for (i = 5 ; i > -1 ; i--) {
+    if ( mask & ( 1 << i ) ) {
+      words[count++] = R[i].whole ;
+      Rwritten[i] = R[i].whole ;
+    }
   }
+  forceWrite &= ~mask ;
+  spi1.write(words, count, onWriteComplete) ;
+  if ( mask != 0 ) profiler.end(PROF_SPI, t) ;
+#else
   for (i = 5 ; i > -1 ; i--) {
-    writeDev(i, R[i]) ;
+    if ( mask & ( 1 << i ) ) writeDev(i, R[i]) ;
     //delayMicroseconds(2500) ;
   }
+  if ( mask != 0 ) profiler.end(PROF_SPI, t) ;
+  if ( onWriteComplete != NULL ) onWriteComplete() ;
+#endif
+}
+
+bool ADF4351::writeBusy()
+{
+#ifdef USE_DMA_SPI
+  return spi1.busy() ;
+#else
+  return false ;
+#endif
+}
+
+void ADF4351::waitWrite()
+{
+#ifdef USE_DMA_SPI
+  spi1.wait() ;
+#endif
+}
+
+int ADF4351::writeRegisters(bool debug)
+{
   if(debug){
-    Serial.println("Written to ADF") ;
+    Serial_println("writing to ADF") ;
+  }
+  writeMask(0x3F) ;
+  if(debug){
+    Serial_println("Written to ADF") ;
   }
 
   return 0 ;  // ok
 }
 
+uint8_t ADF4351::dirtyMask()
+{
+  uint8_t mask = forceWrite ;
+  for (int i = 0 ; i < 6 ; i++) {
+    if ( R[i].whole != Rwritten[i] ) mask |= ( 1 << i ) ;
+  }
+  // MOD, phase, R counter, doubler and charge pump (R1, R2) are
+  // double buffered and only take effect on the next R0 write
+  if ( mask & 0x06 ) mask |= 0x01 ;
+  return mask ;
+}
+
+int ADF4351::writeChanged(bool debug)
+{
+  writeMask(dirtyMask()) ;
+
+  return 0 ;  // ok
+}
+
 void ADF4351::regInfo(){
   int i;
-  Serial.println("Reg Info") ;
+  Serial_println("Reg Info") ;
   for (i = 0 ; i < 6 ; i++) {
-    Serial.print("Register ");
-    Serial.print(i);
-    Serial.print(" = 0b");
+    Serial_print("Register ");
+    Serial_print(i);
+    Serial_print(" = 0b");
     // Get the register value
     uint32_t regValue = R[i].get();
     // Create a padded binary representation
@@ -595,7 +852,7 @@ void ADF4351::regInfo(){
     {
       binaryStr = "0" + binaryStr;
     }
-    Serial.println(binaryStr);
+    Serial_println(binaryStr);
   }
 }
 
@@ -619,45 +876,45 @@ void ADF4351::enable()
 {
   enabled = true ;
   digitalWrite(PIN_CE, HIGH) ;
-  //R[2].setbf(0, 3, 2) ; // control bits
-  //R[2].setbf(26,3,1); //VDD
+  //Adf::Control<2>::set(R) ; // control bits
+  //Adf::MuxOut::set<1>(R) ; //VDD
 
-  R[4].setbf(0, 3, 4) ; // control bits
-  R[4].setbf(5,1,1); //RF Main on
-  R[4].setbf(8,1,1); //RF Aux on
+  Adf::Control<4>::set(R) ; // control bits
+  Adf::RFOutEnable::set<1>(R) ; //RF Main on
+  Adf::AuxOutputEnable::set<1>(R) ; //RF Aux on
 
-  R[5].setbf(0, 3, 5) ; // control bits
-  R[5].setbf(22,2,1); //Lock detect mode
-  writeRegisters(); 
+  Adf::Control<5>::set(R) ; // control bits
+  Adf::LDPinMode::set<1>(R) ; //Lock detect mode
+  writeChanged(); 
 }
 
 void ADF4351::disable()
 {
   enabled = false ;
   digitalWrite(PIN_CE, LOW) ;
-  //R[2].setbf(0, 3, 2) ; // control bits
-  //R[2].setbf(26,3,2); //DGND
+  //Adf::Control<2>::set(R) ; // control bits
+  //Adf::MuxOut::set<2>(R) ; //DGND
 
-  R[4].setbf(0, 3, 4) ; // control bits
-  R[4].setbf(5,1,0); //RF Main off
-  R[4].setbf(8,1,0); //RF Aux off
+  Adf::Control<4>::set(R) ; // control bits
+  Adf::RFOutEnable::set<0>(R) ; //RF Main off
+  Adf::AuxOutputEnable::set<0>(R) ; //RF Aux off
 
-  R[5].setbf(0, 3, 5) ; // control bits
-  R[5].setbf(22,2,0); //Lock detect LOW
-  writeRegisters();  
+  Adf::Control<5>::set(R) ; // control bits
+  Adf::LDPinMode::set<0>(R) ; //Lock detect LOW
+  writeChanged();  
 }
 
 void ADF4351::setPhase(uint16_t phase)
 {
-  R[1].setbf(0, 3, 1) ; // control bits
-  R[1].setbf(15, 12, phase); // phase
-  writeRegisters(); 
+  Adf::Control<1>::set(R) ; // control bits
+  Adf::PhaseValue::set(R, phase) ; // phase
+  writeChanged(); 
 }
 
 double ADF4351::setPhaseAngle(double phaseAngle)
 {
    if(phaseAngle>360 || phaseAngle<0){
-    Serial.println("Phase Angle range is 0-360");
+    Serial_println("Phase Angle range is 0-360");
     phaseAngle=fmodf(phaseAngle,360.0f);
 
   }
@@ -670,15 +927,15 @@ double ADF4351::setPhaseAngle(double phaseAngle)
 uint16_t ADF4351::setAmplitude(uint16_t pwrlevel)
 { 
   if(pwrlevel>3){
-    Serial.println("Amplitude range is 0-3");
+    Serial_println("Amplitude range is 0-3");
     pwrlevel=3;
   } else if(pwrlevel<0){
-    Serial.println("Amplitude range is 0-3");
+    Serial_println("Amplitude range is 0-3");
     pwrlevel=0;
   }
-  R[4].setbf(0, 3, 4) ; // control bits
-  R[4].setbf(3, 2, pwrlevel) ; // output power 0-3 (-4dbM to 5dbM, 3db steps)
-  writeRegisters(); 
+  Adf::Control<4>::set(R) ; // control bits
+  Adf::OutputPower::set(R, pwrlevel) ; // output power 0-3 (-4dbM to 5dbM, 3db steps)
+  writeChanged(); 
   return pwrlevel;
 }
 
@@ -714,19 +971,21 @@ void ADF4351::setSigmaDeltaAmplitude(uint16_t pwrlevel)
   integratedLevel = (integratedLevel + (float)currentLevel)/2.0;
 
   // Update the amplitude level
-  R[4].setbf(0, 3, 4);                       // Control bits
-  R[4].setbf(3, 2, currentLevel);            // Output power 0-3 (-4dBm to 5dBm, 3dB steps)
-  writeRegisters();
+  Adf::Control<4>::set(R) ;                    // Control bits
+  Adf::OutputPower::set(R, currentLevel) ;     // Output power 0-3 (-4dBm to 5dBm, 3dB steps)
+  writeChanged();
 }
 
 void ADF4351::writeDev(int n, Reg r)
 {
   //Serial.println("writeDev") ;
+#if defined(USE_DMA_SPI) || defined(USE_FAST_SPI)
+  spi1.writeWord(r.whole) ;
+#else
   byte  txbyte ;
   int i ;
   digitalWrite(pinSS, LOW) ;
   delayMicroseconds(2) ;
-  i=n ; // not used 
   for ( i = 3 ; i > -1 ; i--) {
     txbyte = (byte) (r.whole >> (i * 8)) ;
     //Serial.println("writeDev Transfer") ;
@@ -735,32 +994,55 @@ void ADF4351::writeDev(int n, Reg r)
   digitalWrite(pinSS, HIGH) ;
   delayMicroseconds(1) ;
   digitalWrite(pinSS, LOW) ;
+#endif
+  Rwritten[n] = r.whole ;
+  forceWrite &= ~( 1 << n ) ;
   //Serial.println("writeDev Complete") ;
 }
 
 
   void ADF4351::freqInfo(){
-    Serial.print("Freq:");
-    Serial.println(cfreq) ;
-    Serial.print("PLL INT:");
-    Serial.println(N_Int);
-    Serial.print("PLL FRAC:");
-    Serial.println(Frac);
-    Serial.print("PLL MOD:");
-    Serial.println(Mod);
-    Serial.print("PLL PFD:");
-    Serial.println(PFDFreq);
-    Serial.print("PLL output divider:");
-    Serial.println(outdiv);
-    Serial.print("PLL prescaler:");
-    Serial.println(Prescaler);
-    Serial.print("Lock Detect:");
-    Serial.println(digitalRead(PIN_LD));
-    Serial.print("RF Enable:");
-    Serial.println(enabled);
+    syncFromRegisters();
+    Serial_print("Freq:");
+    Serial_println(cfreq) ;
+    Serial_print("Freq error (mHz):");
+    Serial_println(ferr_mHz) ;
+    Serial_print("PLL INT:");
+    Serial_println(N_Int);
+    Serial_print("PLL FRAC:");
+    Serial_println(Frac);
+    Serial_print("PLL MOD:");
+    Serial_println(Mod);
+    Serial_print("PLL PFD:");
+    Serial_println(PFDFreq);
+    Serial_print("PLL output divider:");
+    Serial_println(outdiv);
+    Serial_print("PLL prescaler:");
+    Serial_println(Prescaler);
+    Serial_print("Lock Detect:");
+    Serial_println(digitalRead(PIN_LD));
+    Serial_print("RF Enable:");
+    Serial_println(enabled);
+    Serial_print("Plan cache hits:");
+    Serial_println(planCacheHits);
+    Serial_print("Plan cache misses:");
+    Serial_println(planCacheMisses);
+    Serial_print("Delta FRAC retunes:");
+    Serial_println(fracRetunes);
   }
 
 
+uint32_t ADF4351::benchmarkSPI(uint16_t count)
+{
+  // R5 is rewritten with its current value so the output is not disturbed
+  unsigned long start = micros() ;
+  for (uint16_t i = 0 ; i < count ; i++) {
+    writeDev(5, R[5]) ;
+  }
+  unsigned long elapsed = micros() - start ;
+  return (uint32_t) ( ( (uint64_t) elapsed * 1000ULL ) / count ) ;
+}
+
 uint32_t   ADF4351::getReg(int n)
 {
   return R[n].whole ;
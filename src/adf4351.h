@@ -14,20 +14,20 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <stdint.h>
-#include <BigNumber.h>
 
 
 extern uint32_t steps[];  ///< Array of Frequency Step Values
 
 #define NSTEPS 7  ///< Number of Freq Step Values defined
 
-// need to use max unsigned long on arduino , oh well
-#define ADF_FREQ_MAX  4294967295UL    ///< Maximum Generated Frequency = value of MAX Unsigned Long
+#define ADF_FREQ_MAX  4400000000ULL   ///< Maximum Generated Frequency, frequencies are 64 bit
 #define ADF_FREQ_MIN  34385000UL      ///< Minimum Generated Frequency
 #define ADF_PFD_MAX   32000000.0      ///< Maximum Frequency for Phase Detector
 #define ADF_PFD_MIN   125000.0        ///< Minimum Frequency for Phase Detector
 #define ADF_REFIN_MAX   250000000UL   ///< Maximum Reference Frequency
 #define REF_FREQ_DEFAULT 25000000L ///< Default Reference Frequency
+#define ADF_MOD_MAX   4095            ///< Maximum 12 bit MOD value
+#define ADF_PLAN_CACHE_SIZE 16        ///< Number of solved plans kept by planCached()
 
 
 /*!
@@ -77,6 +77,26 @@ class Reg
 
 };
 
+/*!
+   @brief Solved PLL settings for one output frequency
+
+   Filled in by ADF4351::plan() and written to the device with
+   ADF4351::setPlan(). A plan only depends on the frequency and the
+   reference settings, so it can be calculated ahead of time.
+*/
+struct PLLPlan
+{
+  uint64_t freq ;      ///< requested frequency (Hz)
+  uint64_t cfreq ;     ///< generated frequency (Hz, truncated)
+  int32_t ferr_mHz ;   ///< generated - requested frequency (milli Hz)
+  uint16_t N_Int ;     ///< PLL INT value
+  uint16_t Frac ;      ///< PLL FRAC value
+  uint16_t Mod ;       ///< PLL MOD value
+  uint8_t RfDivSel ;   ///< output divider select, outdiv = 1 << RfDivSel
+  uint8_t Prescaler ;  ///< 4/5 (0) or 8/9 (1) prescaler
+  uint8_t FracN ;      ///< 1 keeps the frac-n mode bits when Frac is 0 (shared MOD hop sets)
+};
+
 /*!
    @brief ADF4351 chip device driver
 
@@ -124,7 +144,7 @@ class ADF4351
        @param freq target frequency
        @return success (True or False)
     */
-    int  setf(uint32_t freq, uint16_t phase=1, uint32_t chan_steps=0); // set freq
+    int  setf(uint64_t freq, uint16_t phase=1, uint32_t chan_steps=0); // set freq
     /*!
        sets the reference frequency
        sets the incoming reference frequency to the ADF4351 chip,
@@ -137,13 +157,59 @@ class ADF4351
 
     int lock_freq(bool debug=false);
 
-    int optimise_f_only(uint32_t freq, bool debug=false, bool loginfo=false, bool gcd_method=false);
+    int optimise_f_only(uint64_t freq, bool debug=false, bool loginfo=false);
+   /*!
+      sets the frequency using plan() to find the closest FRAC/MOD pair in a single pass
+      and writes the registers. Steps the current MOD hits exactly take the retuneFrac()
+      fast path, all others go through planCached().
+      Returns 1 if the frequency is out of range.
+    */
+
+    int retuneFrac(uint64_t freq, bool debug=false);
+   /*!
+      fast path for a step that keeps the output divider, prescaler, fractional-N
+      mode and MOD of the current registers, with the current MOD hitting freq
+      exactly. Only INT and FRAC are recalculated and only R0 is written. Returns 1
+      without writing when a new MOD or a full plan is needed.
+    */
+
+    int plan(uint64_t freq, PLLPlan &p);
+   /*!
+      calculates the INT/FRAC/MOD, divider and prescaler settings for freq without
+      writing the device. The closest FRAC/MOD with MOD <= ADF_MOD_MAX is used and
+      the residual error is reported in p.ferr_mHz. Returns 1 if out of range.
+    */
+
+    int planCached(uint64_t freq, PLLPlan &p);
+   /*!
+      same as plan(), but returns the plan from a small LRU cache when freq has been
+      solved recently. The cache is emptied when the reference settings change.
+    */
+
+    int setPlan(const PLLPlan &p, bool debug=false);
+   /*!
+      loads a plan from plan() into the PLL values and writes the registers
+    */
+
+    int setPLLRegisters(bool debug=false);
+   /*!
+      encodes the current PLL values into R0-R5 and writes the registers
+    */
+
+    void syncFromRegisters();
    /*!
-      sets the reference frequency trying to optimise the channel setting for stability
-      and retrying with different settings if a setting would have otherwise failed.
+      reloads N_Int, Frac, Mod, the output divider, prescaler and cfreq from R, which
+      RegTable playback (LFO, sweep and hop) writes without going through the PLL values.
+      ferr_mHz is cleared when they change, the request behind a table entry is not kept
     */
 
-    int setf_only(uint32_t freq, uint32_t chan_steps=0,bool debug=false); // set reference freq
+    void encodePlan(const PLLPlan &p, Reg *regs);
+   /*!
+      encodes a plan and the reference settings into the register array regs
+      without writing the device. regs can be R or a copy of it.
+    */
+
+    int setf_only(uint64_t freq, uint32_t chan_steps=0,bool debug=false); // set reference freq
     /*!
       sets the reference frequency changing minimum number of registers
     */
@@ -160,6 +226,39 @@ class ADF4351
       write complete set of registers via SPI
    */
 
+   int writeChanged(bool debug=false); //Write only the changed registers
+   /*!
+      write only the registers in dirtyMask(), R5 first and R0 last
+   */
+
+   uint8_t dirtyMask();
+   /*!
+      bit n is set if R[n] differs from the value last written to the device.
+      R0 is included whenever R1 or R2 is, to latch their double buffered values.
+   */
+
+   void writeMask(uint8_t mask);
+   /*!
+      write the registers selected by mask, R5 first and R0 last.
+      With USE_DMA_SPI this only starts the transfer, see writeBusy().
+   */
+
+   bool writeBusy();
+   /*!
+      true while an asynchronous (USE_DMA_SPI) register write is in progress
+   */
+
+   void waitWrite();
+   /*!
+      wait for an asynchronous register write to finish
+   */
+
+   void (*onWriteComplete)();
+   /*!
+      optional callback, called once the registers of each write have been latched.
+      With USE_DMA_SPI it is called from the DMA interrupt.
+   */
+
     void enable();
     /*!
        turns off the output frequency (disables the CE pin)
@@ -200,6 +299,13 @@ class ADF4351
 
     void writeDev(int n, Reg r) ;
 
+    /*!
+       times repeated writes of R5 with its current value
+       @param count number of 32 bit register words to write
+       @return average time per register word in ns
+    */
+    uint32_t benchmarkSPI(uint16_t count) ;
+
     /*!
        gets the value of the device register
        @param n nth register on the device
@@ -214,6 +320,41 @@ class ADF4351
        @return the greatest common denominator
     */
     uint32_t gcd_iter(uint32_t u, uint32_t v) ;
+    /*!
+       calculates the PLL values for a frequency using the current ChanStep
+       sets outdiv, RfDivSel, Prescaler, N_Int, Frac, Mod and cfreq
+       @param freq target frequency
+    */
+    void calcPLL(uint64_t freq) ;
+    /*!
+       recalculates PFDFreq and PFDmHz if the reference settings changed
+    */
+    void updatePFD() ;
+    /*!
+       selects the output divider and prescaler for a frequency
+       @param freq target frequency
+       @param prescaler set to the required prescaler
+       @return RfDivSel, the output divider is 1 << RfDivSel
+    */
+    uint8_t selectDivider(uint64_t freq, uint8_t &prescaler) ;
+    /*!
+       solves freq for the given output divider and prescaler using the current PFD
+       @param keepMod MOD to keep if it gives freq exactly, 0 for the closest FRAC/MOD
+       @return 1 if INT is out of range for the prescaler
+    */
+    int solvePlan(uint64_t freq, uint8_t divsel, uint8_t prescaler, uint16_t keepMod, PLLPlan &p) ;
+    /*!
+       number of planCached() calls answered from the cache
+    */
+    uint32_t planCacheHits ;
+    /*!
+       number of planCached() calls that had to run plan()
+    */
+    uint32_t planCacheMisses ;
+    /*!
+       number of retunes done by the retuneFrac() fast path
+    */
+    uint32_t fracRetunes ;
     /*!
        stores the SPI settings
     */
@@ -226,6 +367,14 @@ class ADF4351
        array for storing the working register values (used for writing)
     */
     Reg R[6] ;
+    /*!
+       the register values last written to the device (used for dirtyMask())
+    */
+    uint32_t Rwritten[6] ;
+    /*!
+       the registers (bit n = Rn) sent by the last write, valid in onWriteComplete
+    */
+    uint8_t lastWriteMask ;
     /*!
        stores the reference frequency
     */
@@ -239,7 +388,12 @@ class ADF4351
        used to check for issues in the setf() function.
        this value is overwritten each time sef() is called.
     */
-    uint32_t cfreq ;
+    uint64_t cfreq ;
+    /*!
+       the difference between the generated and the requested frequency in milli Hz
+       set by optimise_f_only(), zero when set by setf_only()
+    */
+    int32_t ferr_mHz ;
     /*!
        stores the PLL INT value for the current frequency
        this value is overwritten each time sef() is called.
@@ -260,6 +414,10 @@ class ADF4351
        can be changed if a new reference frequency is used.
     */
     float PFDFreq ;
+    /*!
+       The PLL Phase Detect Freq in milli Hz, used for the integer calculations
+    */
+    uint64_t PFDmHz ;
     /*!
        the channel step value
        can be directly changed to set a new frequency step
@@ -272,6 +430,11 @@ class ADF4351
        this value is overwritten each time sef() is called.
     */
     int outdiv ;
+    /*!
+       the R4 output divider select value (log2 of outdiv)
+       this value is overwritten each time sef() is called.
+    */
+    uint8_t RfDivSel ;
     /*!
        the PLL ref freq doubler flag for the current frequency
        it is used to double the incoming ref frequency.
@@ -313,6 +476,23 @@ class ADF4351
     unsigned long SPIspeed;
     uint8_t SPIorder;
 
+  private:
+    // registers that must be written regardless of Rwritten (set by init())
+    uint8_t forceWrite ;
+    // reference settings used for the cached PFDmHz value
+    bool pfdValid ;
+    uint32_t pfdRef ;
+    int pfdRCounter ;
+    uint8_t pfdRefDouble ;
+    uint8_t pfdRdiv2 ;
+    // the registers hold a full plan for the current reference, needed by retuneFrac()
+    bool fracReady ;
+    // planCached() entries, planCacheUse holds the planCacheClock value of the last use
+    PLLPlan planCache[ADF_PLAN_CACHE_SIZE] ;
+    uint32_t planCacheUse[ADF_PLAN_CACHE_SIZE] ;
+    uint32_t planCacheClock ;
+    uint8_t planCacheCount ;
+
 };
 
 
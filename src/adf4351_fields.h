@@ -0,0 +1,151 @@
+/*!
+   @file adf4351_fields.h
+
+   Compile time descriptors for the ADF4351 register bit fields.
+
+   Each field is a type carrying its register number, start bit and length,
+   so masks and shifts are constants and an encode compiles to a mask-and-or.
+   Writing a field of the wrong register or a constant that does not fit is
+   a compile error.
+
+   @code
+   Adf::MuxOut::set<6>(R) ;        // constant, range checked by static_assert
+   Adf::FracValue::set(R, Frac) ;  // run time value, truncated to the field
+   @endcode
+*/
+
+#ifndef ADF4351_FIELDS_H
+#define ADF4351_FIELDS_H
+
+#include <stdint.h>
+
+namespace Adf
+{
+
+/*!
+   @brief ADF4351 register bit field
+
+   @tparam REG register number 0-5
+   @tparam START index of the least significant bit
+   @tparam LEN number of bits
+*/
+template <uint8_t REG, uint8_t START, uint8_t LEN>
+struct Field
+{
+  static_assert(REG < 6, "ADF4351 has registers R0-R5") ;
+  static_assert(LEN > 0 && START + LEN <= 32, "field must fit in 32 bits") ;
+
+  static constexpr uint8_t reg = REG ;
+  static constexpr uint32_t max = ( LEN == 32 ) ? 0xFFFFFFFFUL : ( ( 1UL << LEN ) - 1UL ) ;
+  static constexpr uint32_t mask = max << START ;
+
+  /*!
+     @return value shifted and masked into position
+  */
+  static constexpr uint32_t encode(uint32_t value)
+  {
+    return ( value << START ) & mask ;
+  }
+
+  /*!
+     @return the field value from a register word
+  */
+  static constexpr uint32_t decode(uint32_t word)
+  {
+    return ( word & mask ) >> START ;
+  }
+
+  /*!
+     sets the field in the register array, value is truncated to LEN bits
+  */
+  template <typename R>
+  static inline void set(R *regs, uint32_t value)
+  {
+    regs[REG].whole = ( regs[REG].whole & ~mask ) | encode(value) ;
+  }
+
+  /*!
+     sets the field to a constant, checked against the field size
+  */
+  template <uint32_t VALUE, typename R>
+  static inline void set(R *regs)
+  {
+    static_assert(VALUE <= max, "value too large for the ADF4351 field") ;
+    regs[REG].whole = ( regs[REG].whole & ~mask ) | encode(VALUE) ;
+  }
+
+  /*!
+     @return the field value from the register array
+  */
+  template <typename R>
+  static inline uint32_t get(const R *regs)
+  {
+    return decode(regs[REG].whole) ;
+  }
+};
+
+/*!
+   control bits (0,3) of register N, always equal to N
+*/
+template <uint8_t N>
+struct Control : Field<N, 0, 3>
+{
+  template <typename R>
+  static inline void set(R *regs)
+  {
+    Field<N, 0, 3>::template set<N>(regs) ;
+  }
+};
+
+// R0
+typedef Field<0, 3, 12>  FracValue ;       ///< 12 bit fractional value
+typedef Field<0, 15, 16> IntValue ;        ///< 16 bit integer value
+
+// R1
+typedef Field<1, 3, 12>  ModValue ;        ///< 12 bit modulus value
+typedef Field<1, 15, 12> PhaseValue ;      ///< 12 bit phase value
+typedef Field<1, 27, 1>  Prescaler ;       ///< 4/5 (0) or 8/9 (1)
+typedef Field<1, 28, 1>  PhaseAdjust ;
+
+// R2
+typedef Field<2, 3, 1>   CounterReset ;
+typedef Field<2, 4, 1>   CP3State ;
+typedef Field<2, 5, 1>   PowerDown ;
+typedef Field<2, 6, 1>   PDPolarity ;
+typedef Field<2, 7, 1>   LDP ;             ///< lock detect precision
+typedef Field<2, 8, 1>   LDF ;             ///< lock detect function
+typedef Field<2, 9, 4>   ChargePump ;      ///< charge pump current setting
+typedef Field<2, 13, 1>  DoubleBuffer ;
+typedef Field<2, 14, 10> RCounter ;
+typedef Field<2, 24, 1>  RDiv2 ;
+typedef Field<2, 25, 1>  RefDoubler ;
+typedef Field<2, 26, 3>  MuxOut ;
+typedef Field<2, 29, 2>  NoiseMode ;       ///< low noise and spur mode
+
+// R3
+typedef Field<3, 3, 12>  ClkDiv ;          ///< 12 bit clock divider value
+typedef Field<3, 15, 2>  ClkDivMode ;
+typedef Field<3, 18, 1>  CSR ;             ///< cycle slip reduction
+typedef Field<3, 21, 1>  ChargeCancel ;
+typedef Field<3, 22, 1>  ABP ;             ///< antibacklash pulse width
+typedef Field<3, 23, 1>  BandSelClkMode ;
+
+// R4
+typedef Field<4, 3, 2>   OutputPower ;
+typedef Field<4, 5, 1>   RFOutEnable ;
+typedef Field<4, 6, 2>   AuxOutputPower ;
+typedef Field<4, 8, 1>   AuxOutputEnable ;
+typedef Field<4, 9, 1>   AuxOutputSelect ;
+typedef Field<4, 10, 1>  MTLD ;            ///< mute till lock detect
+typedef Field<4, 11, 1>  VCOPowerDown ;
+typedef Field<4, 12, 8>  BandSelClkDiv ;
+typedef Field<4, 20, 3>  RFDivSel ;
+typedef Field<4, 23, 1>  FeedbackSelect ;
+
+// R5
+typedef Field<5, 19, 2>  Reserved5 ;       ///< reserved, must be set to 11
+typedef Field<5, 22, 2>  LDPinMode ;
+
+}
+
+#endif
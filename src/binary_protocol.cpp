@@ -0,0 +1,178 @@
+//
+//  binary_protocol.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Binary framed command protocol for automated test rigs.
+//
+
+#include <Arduino.h>
+#include "brd_ltdz_stm32f103cb.h"
+#include "binary_protocol.h"
+#include "command_parser.h"
+
+uint16_t crc16(const uint8_t *data, uint16_t len, uint16_t crc)
+{
+  while (len--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static void reply(uint8_t opcode, uint8_t status, uint64_t value)
+{
+  uint8_t out[14];
+  out[0] = BIN_SYNC;
+  out[1] = 10;
+  out[2] = opcode | 0x80;
+  out[3] = status;
+  for (uint8_t i = 0; i < 8; i++) {
+    out[4 + i] = value >> (8 * i);
+  }
+  uint16_t crc = crc16(&out[1], 11);
+  out[12] = crc;
+  out[13] = crc >> 8;
+  Serial_write(out, sizeof(out));
+}
+
+BinaryProtocol::BinaryProtocol()
+  : active_(false), magicStarted_(false), state_(WAIT_SYNC), received_(0), frameCrc_(0), lastByteMs_(0)
+{
+}
+
+bool BinaryProtocol::magic(uint8_t c)
+{
+  if (c == BIN_SYNC) {
+    magicStarted_ = true;
+    return true;
+  }
+  if (magicStarted_ && c == BIN_MAGIC) {
+    magicStarted_ = false;
+    active_ = true;
+    state_ = WAIT_SYNC;
+    reply(BIN_OP_NOP, BIN_STATUS_OK, 0);
+    return true;
+  }
+  magicStarted_ = false;
+  return false;
+}
+
+//Convert the payload to the text command line of the matching letter, line must hold
+//BIN_MAX_LEN + 22 characters. With text set the payload has no binary argument
+static void payloadToLine(char letter, const uint8_t *payload, uint8_t len, bool text, char *line)
+{
+  uint8_t n = 0;
+  line[n++] = letter;
+  uint8_t size = 4;
+  if (letter == 'M' || text) {
+    size = 0; //All text
+  } else if (letter == 'F' && len == 8) {
+    size = 8;
+  }
+  uint8_t prefix = (size > 0 && len >= size) ? len - size : len;
+  for (uint8_t i = 0; i < prefix; i++) {
+    line[n++] = toupper(payload[i]);
+  }
+  line[n] = 0;
+  if (prefix == len) {
+    return;
+  }
+  uint64_t raw = 0;
+  for (uint8_t i = 0; i < size; i++) {
+    raw |= (uint64_t)payload[prefix + i] << (8 * i);
+  }
+  if (letter == 'F') {
+    formatInt64(&line[n], (int64_t)raw); //Unsigned, 4 or 8 bytes
+  } else if (letter == 'P') {
+    int32_t milli = (int32_t)(uint32_t)raw;
+    if (milli < 0) {
+      line[n++] = '-';
+    }
+    uint32_t mag = milli < 0 ? 0 - (uint32_t)milli : (uint32_t)milli;
+    n += formatInt64(&line[n], mag / 1000);
+    line[n++] = '.';
+    line[n++] = '0' + mag / 100 % 10;
+    line[n++] = '0' + mag / 10 % 10;
+    line[n++] = '0' + mag % 10;
+    line[n] = 0;
+  } else {
+    formatInt64(&line[n], (int32_t)(uint32_t)raw);
+  }
+}
+
+void BinaryProtocol::runFrame(BinaryHandler handler)
+{
+  uint8_t len = frame_[0];
+  uint8_t opcode = frame_[1];
+  uint64_t value = 0;
+  uint8_t status = BIN_STATUS_UNSUPPORTED;
+  char line[BIN_MAX_LEN + 22];
+  uint8_t command = opcode & ~BIN_OP_TEXT;
+  if (command >= 1 && command <= 26) {
+    payloadToLine('A' + command - 1, &frame_[2], len - 1, (opcode & BIN_OP_TEXT) != 0, line);
+    status = handler(line, value);
+  } else if (opcode == BIN_OP_NOP || opcode == BIN_OP_EXIT) {
+    line[0] = 0;
+    status = handler(line, value); //An empty line runs nothing, just fills in value
+  }
+  reply(opcode, status, value);
+  if (opcode == BIN_OP_EXIT) {
+    active_ = false;
+  }
+}
+
+void BinaryProtocol::byte(uint8_t c, BinaryHandler handler)
+{
+  uint32_t now = millis();
+  if (state_ != WAIT_SYNC && now - lastByteMs_ > BIN_FRAME_TIMEOUT_MS) {
+    state_ = WAIT_SYNC; //Stale partial frame
+  }
+  lastByteMs_ = now;
+
+  switch (state_) {
+    case WAIT_SYNC:
+      if (c == BIN_SYNC) {
+        state_ = WAIT_LEN;
+      }
+      break;
+    case WAIT_LEN:
+      if (c == 0 || c > BIN_MAX_LEN) {
+        reply(0, BIN_STATUS_LENGTH, 0);
+        state_ = WAIT_SYNC;
+        break;
+      }
+      frame_[0] = c;
+      received_ = 0;
+      state_ = BODY;
+      break;
+    case BODY:
+      frame_[1 + received_++] = c;
+      if (received_ == frame_[0]) {
+        state_ = CRC_LO;
+      }
+      break;
+    case CRC_LO:
+      frameCrc_ = c;
+      state_ = CRC_HI;
+      break;
+    case CRC_HI:
+      frameCrc_ |= (uint16_t)c << 8;
+      state_ = WAIT_SYNC;
+      if (frameCrc_ != crc16(frame_, frame_[0] + 1)) {
+        reply(frame_[1], BIN_STATUS_CRC, 0);
+        break;
+      }
+      runFrame(handler);
+      break;
+  }
+}
@@ -0,0 +1,93 @@
+//
+//  binary_protocol.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Binary framed command protocol for automated test rigs.
+// Sending BIN_SYNC BIN_MAGIC in text mode switches that port's session to binary mode,
+// where nothing is echoed and each command is a frame:
+//
+//   BIN_SYNC, len, opcode, payload[len-1], crc16 low, crc16 high
+//
+// The CRC16 (CCITT, 0x1021, initial 0xFFFF) covers len, opcode and payload.
+// Opcodes 1-26 run the A-Z text commands. The payload is an optional ASCII prefix
+// (sub command letters such as R for XR) followed by an optional little endian int32
+// argument, so 0 bytes = no argument, 4 bytes = argument, 1-3 bytes = prefix only.
+// M takes its whole payload as text, P takes its argument in 1/1000 degrees and
+// F takes an unsigned 4 or 8 byte frequency (8 bytes for 4294967296 Hz and above).
+// Opcodes 1-26 plus BIN_OP_TEXT (33-58) run the same commands with the whole payload
+// as text, for the sub commands that take a comma separated list (FS, NA and XM).
+// Every frame is answered with:
+//
+//   BIN_SYNC, 10, opcode | 0x80, status, value (uint64 little endian), crc16 low, crc16 high
+//
+// where value is the generated frequency in Hz. BIN_OP_EXIT returns to text mode.
+//
+
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <Arduino.h>
+
+#define BIN_SYNC   0xA5
+#define BIN_MAGIC  0x5A
+
+#define BIN_MAX_LEN          64  ///< Maximum len field (opcode and payload)
+#define BIN_FRAME_TIMEOUT_MS 100 ///< A partial frame older than this is dropped
+
+#define BIN_OP_NOP   0x00 ///< no command, replies with the current frequency
+#define BIN_OP_TEXT  0x20 ///< added to an A-Z opcode to take the whole payload as text
+#define BIN_OP_EXIT  0x7F ///< leave binary mode after the reply
+
+#define BIN_STATUS_OK          0
+#define BIN_STATUS_CRC         1 ///< frame CRC did not match, nothing was run
+#define BIN_STATUS_LENGTH      2 ///< len was 0 or over BIN_MAX_LEN
+#define BIN_STATUS_UNSUPPORTED 3 ///< unknown opcode or a text only command (H, I, Q, R)
+
+//Runs a decoded command as its text command line, returns a BIN_STATUS_ value and sets
+//value for the reply. line is empty for BIN_OP_NOP and BIN_OP_EXIT, which only need value
+typedef uint8_t (*BinaryHandler)(const char *line, uint64_t &value);
+
+uint16_t crc16(const uint8_t *data, uint16_t len, uint16_t crc=0xFFFF);
+
+//Frame decoder for one serial port, replies are sent with Serial_write
+class BinaryProtocol
+{
+  public:
+    BinaryProtocol();
+
+    //True while binary frames are expected instead of text
+    bool active() const { return active_; }
+
+    //Text mode: checks c for the entry sequence. Returns true if c was consumed,
+    //false if it should be handled as text
+    bool magic(uint8_t c);
+
+    //Binary mode: feeds one received byte, calling handler when a frame is complete
+    void byte(uint8_t c, BinaryHandler handler);
+
+    //Drops any partial frame, e.g. after received bytes were lost
+    void resync() { state_ = WAIT_SYNC; }
+
+  private:
+    enum State { WAIT_SYNC, WAIT_LEN, BODY, CRC_LO, CRC_HI };
+
+    void runFrame(BinaryHandler handler);
+
+    bool active_;
+    bool magicStarted_;
+    State state_;
+    uint8_t frame_[BIN_MAX_LEN + 1]; ///< len, opcode, payload
+    uint8_t received_;
+    uint16_t frameCrc_;
+    uint32_t lastByteMs_;
+};
+
+#endif
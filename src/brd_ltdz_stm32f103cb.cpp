@@ -16,6 +16,7 @@
 
 #include <Arduino.h>
 #include "brd_ltdz_stm32f103cb.h"
+#include "uart_dma.h"
 
 #include "USBSerial.h"
 //#include <SPI.h>
@@ -68,38 +69,49 @@ void oled_setup(){
     // display.println("ADF4351 Test");
 }
 
+bool serialMute = false;
+
 void setupSerial(uint32_t baud) {
 #ifdef USE_USB_SERIAL
   SerialUSB.begin(baud); // Use USB Serial (Serial)
 #endif
 #ifdef USE_HARDWARE_SERIAL
-  Serial2.begin(baud); // Use Hardware Serial (Serial2)
+  uartDmaBegin(baud); // Use Hardware Serial (Serial2) with DMA receive
 #endif
 }
 
-int Serial_available(){
+int Serial_available(uint8_t ports){
  int count=0;
+ serialTx.service(); //Keep the output queues moving while waiting for input
 #ifdef USE_HARDWARE_SERIAL
- count+=Serial2.available();
+ if (ports & SERIAL_PORT_UART) {
+   count+=uartDmaAvailable();
+ }
 #endif
 #ifdef USE_USB_SERIAL
-  count+=SerialUSB.available();
+  if (ports & SERIAL_PORT_USB) {
+    count+=SerialUSB.available();
+  }
 #endif
   return (count>0);
 }
 
+int Serial_available(){
+  return Serial_available(serialTx.route);
+}
+
 
 int readSerialData() {
   int data=0;
-  // Check for available data
+  // Check for available data on the port of the current command session
 #ifdef USE_HARDWARE_SERIAL
-  if (Serial2.available()>0) {
-    data = Serial2.read();
+  if ((serialTx.route & SERIAL_PORT_UART) && uartDmaAvailable()>0) {
+    data = uartDmaRead();
     return data;
   }
 #endif
 #ifdef USE_USB_SERIAL
-  if (SerialUSB.available()>0) {
+  if ((serialTx.route & SERIAL_PORT_USB) && SerialUSB.available()>0) {
       data = SerialUSB.read();
       return data;
   }
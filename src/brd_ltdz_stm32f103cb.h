@@ -34,6 +34,8 @@
 #ifndef BRD_LTDZ_H
 #define BRD_LTDZ_H
 
+#include "serial_tx.h"
+
 //OLED display
 #define OLED_MOSI     PA7
 #define OLED_CLK      PA6
@@ -42,7 +44,7 @@
 #define OLED_RST      PA5
 
 //ADF4351
-#define PIN_LD   PA8    ///< Ard Pin for Lock Detect **Not Used - LED only**
+#define PIN_LD   PA8    ///< Ard Pin for Lock Detect (LED, and timed by lock_detect.cpp)
 
 #define PIN_CE   PB12    ///< Ard Pin for Chip Enable
 #define PIN_SS   PB13    ///< Ard Pin for SPI ADF Select **PIN_LE**
@@ -50,6 +52,33 @@
 #define PIN_MISO  PB11  ///< Ard Pin for SPI MISO
 #define PIN_SCK  PB15   ///< Ard Pin for SPI CLK
 
+//Write the ADF4351 registers with direct GPIOB BSRR writes (fast_spi.cpp)
+//comment out to use the digitalWrite based BitBangedSPI library
+#define USE_FAST_SPI
+
+//Write the ADF4351 registers in the background with TIM4 + DMA1 channel 7 (dma_spi.cpp)
+//register writes then return before the words have been shifted out
+//#define USE_DMA_SPI
+
+//Timer for the fixed rate modulation scheduler (mod_scheduler.cpp, U command)
+#define MOD_TIMER TIM3
+#define MOD_TIMER_IRQn TIM3_IRQn
+
+//Timer for the stepped frequency sweep (sweep.cpp, FS command)
+#define SWEEP_TIMER TIM1
+#define SWEEP_TIMER_IRQn TIM1_UP_IRQn
+
+//Hop list trigger input, rising edge moves to the next entry (hop_table.cpp, N command).
+//The edge is captured by a timer channel on the pin, so the latency includes the
+//interrupt entry. KEY1BIT PA1 is TIM2_CH2
+#define HOP_TRIGGER_PIN KEY1BIT
+#define HOP_TRIGGER_TIMER TIM2
+#define HOP_TRIGGER_CHANNEL 2
+#define HOP_TRIGGER_IRQn TIM2_IRQn
+
+//Lock detect edge interrupt for PIN_LD (PA8, EXTI line 8), lock_detect.cpp, QL command
+#define LOCK_DETECT_IRQn EXTI9_5_IRQn
+
 //KEYPAD PB0,PB1, PA1, PA2, PA3
 #define KEY1BIT PA1 //LEFT 
 #define KEY2BIT PA3 //DOWN
@@ -69,14 +98,21 @@ void oled_setup();
 #define USE_HARDWARE_SERIAL
 
 void setupSerial(uint32_t baud);
+//Reads from the ports in serialTx.route, the port of the current command session
 int readSerialData();
 
 int Serial_available();
+//True if any of the SERIAL_PORT_ mask ports has received data
+int Serial_available(uint8_t ports);
+
+//Set while binary protocol commands run, suppresses the Serial_print text replies
+extern bool serialMute;
 
-// Custom print function using a macro to redirect to the appropriate Serial print function
+// Custom print function using a macro to queue output for the port the command came from (serial_tx.cpp)
 //#ifdef USE_USB_SERIAL
-    #define Serial_print(...) SerialUSB.print(__VA_ARGS__);Serial2.print(__VA_ARGS__)
-    #define Serial_println(...) SerialUSB.println(__VA_ARGS__);Serial2.println(__VA_ARGS__)
+    #define Serial_print(...) do { if (!serialMute) { serialTx.print(__VA_ARGS__); } } while (0)
+    #define Serial_println(...) do { if (!serialMute) { serialTx.println(__VA_ARGS__); } } while (0)
+    #define Serial_write(...) do { serialTx.write(__VA_ARGS__); } while (0)
 //#endif
 //#ifdef USE_HARDWARE_SERIAL
 //   #define Serial_print(...) Serial2.print(__VA_ARGS__)
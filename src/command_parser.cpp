@@ -0,0 +1,171 @@
+//
+//  command_parser.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Fixed size command line buffer and in-place tokenizer for the serial commands.
+//
+
+#include <Arduino.h>
+#include "command_parser.h"
+
+static const uint64_t INT64_MAG_MAX = 0x7FFFFFFFFFFFFFFFULL;
+
+//Accumulate decimal digits into mag, returns false (saturated at limit) on overflow
+static bool addDigits(const char *&s, uint64_t &mag, uint64_t limit, uint8_t maxDigits, uint8_t &count)
+{
+  bool ok = true;
+  count = 0;
+  while (*s >= '0' && *s <= '9' && count < maxDigits) {
+    uint8_t d = *s++ - '0';
+    count++;
+    if (mag > (limit - d) / 10) {
+      mag = limit;
+      ok = false;
+    } else if (ok) {
+      mag = mag * 10 + d;
+    }
+  }
+  return ok;
+}
+
+static const char *skipSign(const char *s, bool &negative)
+{
+  while (*s == ' ' || *s == '\t') {
+    s++;
+  }
+  negative = false;
+  if (*s == '-' || *s == '+') {
+    negative = (*s == '-');
+    s++;
+  }
+  return s;
+}
+
+bool parseInt64(const char *s, int64_t &v, const char **end)
+{
+  return parseFixed(s, 0, v, end);
+}
+
+bool parseFixed(const char *s, uint8_t decimals, int64_t &v, const char **end)
+{
+  bool negative;
+  s = skipSign(s, negative);
+  uint64_t limit = negative ? INT64_MAG_MAX + 1 : INT64_MAG_MAX;
+  uint64_t mag = 0;
+  uint8_t digits;
+  bool ok = addDigits(s, mag, limit, 255, digits);
+  bool any = digits > 0;
+  if (decimals > 0) {
+    uint8_t fracDigits = 0;
+    if (*s == '.') {
+      s++;
+      ok &= addDigits(s, mag, limit, decimals, fracDigits);
+      any |= fracDigits > 0;
+      while (*s >= '0' && *s <= '9') {
+        s++; //Truncate the digits past the resolution
+      }
+    }
+    //Scale by the fraction digits that were not given
+    for (; fracDigits < decimals; fracDigits++) {
+      if (mag > limit / 10) {
+        mag = limit;
+        ok = false;
+      } else {
+        mag *= 10;
+      }
+    }
+  }
+  if (end != NULL) {
+    *end = s;
+  }
+  v = negative ? (int64_t)(0 - mag) : (int64_t)mag;
+  return ok && any;
+}
+
+uint8_t parseList(const char *s, int64_t *values, uint8_t max)
+{
+  uint8_t n = 0;
+  while (n < max) {
+    while (*s == ',' || *s == ' ') {
+      s++;
+    }
+    if (!parseInt64(s, values[n], &s)) {
+      break;
+    }
+    n++;
+  }
+  return n;
+}
+
+uint8_t formatInt64(char *buf, int64_t v)
+{
+  char tmp[20];
+  uint8_t n = 0;
+  uint8_t len = 0;
+  uint64_t mag = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+  do {
+    tmp[n++] = '0' + mag % 10;
+    mag /= 10;
+  } while (mag != 0);
+  if (v < 0) {
+    buf[len++] = '-';
+  }
+  while (n > 0) {
+    buf[len++] = tmp[--n];
+  }
+  buf[len] = 0;
+  return len;
+}
+
+int32_t CmdArgs::toInt() const
+{
+  if (value > INT32_MAX) {
+    return INT32_MAX;
+  } else if (value < INT32_MIN) {
+    return INT32_MIN;
+  }
+  return (int32_t)value;
+}
+
+bool CmdArgs::startsWith(const char *prefix) const
+{
+  return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+CmdArgs CmdArgs::sub(uint8_t n) const
+{
+  CmdArgs args;
+  uint8_t len = strlen(text);
+  args.letter = letter;
+  args.text = text + (n < len ? n : len);
+  args.number = parseInt64(args.text, args.value);
+  parseFixed(args.text, 3, args.milli);
+  return args;
+}
+
+void cmdParse(const char *line, CmdArgs &args)
+{
+  args.letter = line[0];
+  args.text = line[0] != 0 ? line + 1 : line;
+  //value is 0 when there is no number, as String::toInt()
+  args.number = parseInt64(args.text, args.value);
+  parseFixed(args.text, 3, args.milli);
+}
+
+void CommandLine::add(char c)
+{
+  if (length_ >= CMD_LINE_MAX) {
+    overflow_ = true;
+    return;
+  }
+  buf_[length_++] = c;
+  buf_[length_] = 0;
+}
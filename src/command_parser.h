@@ -0,0 +1,82 @@
+//
+//  command_parser.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Fixed size command line buffer and in-place tokenizer for the serial commands.
+// Nothing is allocated: the line lives in a static buffer and the argument is a pointer into it.
+// The number parsers are overflow safe and 64 bit, so frequencies above 4294967295 Hz parse.
+//
+
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <Arduino.h>
+
+#define CMD_LINE_MAX 96 ///< Longest command line, longer lines are rejected
+
+//Parse a signed decimal integer after optional spaces, stopping at the first non digit.
+//Returns false if there are no digits or the value does not fit (v is then saturated).
+//end, if given, is set to the first character after the number
+bool parseInt64(const char *s, int64_t &v, const char **end = NULL);
+
+//Parse a signed decimal number such as -12.345, v is scaled by 10^decimals and extra
+//fraction digits are truncated. Returns false as parseInt64()
+bool parseFixed(const char *s, uint8_t decimals, int64_t &v, const char **end = NULL);
+
+//Parse up to max integers separated by commas or spaces, returns how many were found
+uint8_t parseList(const char *s, int64_t *values, uint8_t max);
+
+//Write v in decimal to buf (at least 21 bytes) with a terminating NUL, returns the length
+uint8_t formatInt64(char *buf, int64_t v);
+
+//A command split into its letter and argument
+struct CmdArgs
+{
+  char letter;       ///< command letter, 0 for an empty line
+  const char *text;  ///< the rest of the line after the letter
+  int64_t value;     ///< leading integer of text, 0 if there is none
+  int64_t milli;     ///< leading decimal number of text in 1/1000 units
+  bool number;       ///< text starts with a number that fits in 64 bits
+
+  //value saturated to the int32_t range, the equivalent of String::toInt()
+  int32_t toInt() const;
+  bool startsWith(const char *prefix) const;
+  //Arguments after the first n characters of text, e.g. the rate after XR
+  CmdArgs sub(uint8_t n) const;
+};
+
+//Tokenize a NUL terminated line in place
+void cmdParse(const char *line, CmdArgs &args);
+
+//Receive buffer for one text line
+class CommandLine
+{
+  public:
+    CommandLine() : length_(0), overflow_(false), lost_(false) { buf_[0] = 0; }
+
+    //Append a character, characters past CMD_LINE_MAX set overflow() and are dropped
+    void add(char c);
+    void clear() { length_ = 0; overflow_ = false; lost_ = false; buf_[0] = 0; }
+    const char *text() const { return buf_; }
+    uint8_t length() const { return length_; }
+    bool overflow() const { return overflow_; }
+    //Input was lost part way through the line, it is dropped at the line end
+    void lose() { lost_ = true; }
+    bool lost() const { return lost_; }
+
+  private:
+    char buf_[CMD_LINE_MAX + 1];
+    uint8_t length_;
+    bool overflow_;
+    bool lost_;
+};
+
+#endif
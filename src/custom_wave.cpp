@@ -0,0 +1,83 @@
+//
+//  custom_wave.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: User uploaded modulation waveform for the LFO (C command).
+//
+
+#include <Arduino.h>
+#include "brd_ltdz_stm32f103cb.h"
+#include "custom_wave.h"
+
+int16_t customWave[CUSTOM_WAVE_MAX];
+uint16_t customWaveSize = 0;
+uint16_t customWaveId = 0;
+
+int32_t customWaveSample(uint32_t phase)
+{
+  if (customWaveSize == 0) {
+    return 0;
+  }
+  //Phase scaled to the table length, integer part indexes and the top 16 bits of the fraction interpolate
+  uint64_t pos = (uint64_t)phase * customWaveSize;
+  uint32_t index = pos >> 32;
+  int32_t frac = (uint32_t)pos >> 16;
+  uint32_t next = (index + 1 == customWaveSize) ? 0 : index + 1;
+  int32_t s0 = customWave[index];
+  int32_t s1 = customWave[next];
+  return (int32_t)(((int64_t)s0 << 16) + (int64_t)(s1 - s0) * frac);
+}
+
+//Wait for the next byte, -1 on timeout
+static int readByte(uint32_t timeout_ms)
+{
+  uint32_t start = millis();
+  while (!Serial_available()) {
+    if (millis() - start > timeout_ms) {
+      return -1;
+    }
+  }
+  return readSerialData();
+}
+
+static int32_t readWord(uint32_t timeout_ms)
+{
+  int lo = readByte(timeout_ms);
+  if (lo < 0) {
+    return -1;
+  }
+  int hi = readByte(timeout_ms);
+  if (hi < 0) {
+    return -1;
+  }
+  return (uint16_t)(lo | (hi << 8));
+}
+
+int32_t customWaveUpload(uint32_t timeout_ms)
+{
+  //The table is unusable until the whole block has arrived
+  customWaveSize = 0;
+  customWaveId++;
+
+  int32_t count = readWord(timeout_ms);
+  if (count < 2 || count > CUSTOM_WAVE_MAX) {
+    return -1;
+  }
+  for (int32_t i = 0; i < count; i++) {
+    int32_t sample = readWord(timeout_ms);
+    if (sample < 0) {
+      return -1;
+    }
+    customWave[i] = (int16_t)sample;
+  }
+  customWaveSize = count;
+  return count;
+}
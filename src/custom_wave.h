@@ -0,0 +1,37 @@
+//
+//  custom_wave.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: User uploaded modulation waveform for the LFO (C command).
+// The table holds signed 16 bit samples covering one LFO cycle and is played
+// with the same phase accumulator and linear interpolation as sin2048[].
+//
+
+#ifndef CUSTOM_WAVE_H
+#define CUSTOM_WAVE_H
+
+#include <Arduino.h>
+
+#define CUSTOM_WAVE_MAX 1024 ///< Maximum number of samples (2 bytes RAM each)
+
+extern int16_t customWave[CUSTOM_WAVE_MAX];
+extern uint16_t customWaveSize;  ///< number of samples loaded, 0 if none
+extern uint16_t customWaveId;    ///< incremented on every upload
+
+//Interpolated sample at an LFO phase (one cycle is 2^32), scaled to +/-2^31
+int32_t customWaveSample(uint32_t phase);
+
+//Receive a length prefixed binary block from the serial ports:
+//uint16 sample count (2-CUSTOM_WAVE_MAX) then the int16 samples, all little endian.
+//Returns the number of samples loaded, or -1 on a timeout or bad count
+int32_t customWaveUpload(uint32_t timeout_ms);
+
+#endif
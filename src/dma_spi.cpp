@@ -0,0 +1,122 @@
+//
+//  dma_spi.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Non-blocking ADF4351 register writer using TIM4 update events to
+// trigger DMA1 channel 7 transfers of pre-rendered BSRR values to GPIOB.
+// MOSI, SCK and LE must all be on GPIOB (PB14, PB15, PB13 on the LTDZ board).
+//
+
+#include <Arduino.h>
+#include "dma_spi.h"
+
+static dmaSPI *dmaSPIInstance = NULL;
+
+extern "C" void DMA1_Channel7_IRQHandler(void)
+{
+  if (dmaSPIInstance != NULL) {
+    dmaSPIInstance->irq();
+  }
+}
+
+void dmaSPI::begin()
+{
+  pinMode(mosi_, OUTPUT);
+  pinMode(sck_, OUTPUT);
+  pinMode(le_, OUTPUT);
+  mosiMask_ = digitalPinToBitMask(mosi_);
+  sckMask_ = digitalPinToBitMask(sck_);
+  leMask_ = digitalPinToBitMask(le_);
+  GPIOB->BSRR = (sckMask_ | mosiMask_ | leMask_) << 16;
+  busy_ = false;
+  done_ = NULL;
+  next_ = 0;
+  dmaSPIInstance = this;
+
+  //TIM4 update event requests one DMA transfer per period
+  RCC->APB1ENR |= RCC_APB1ENR_TIM4EN;
+  TIM4->CR1 = 0;
+  TIM4->PSC = 0;
+  TIM4->ARR = (F_CPU / DMA_SPI_RATE_HZ) - 1;
+  TIM4->DIER = TIM_DIER_UDE;
+
+  //DMA1 channel 7 (TIM4_UP): 32 bit memory to GPIOB->BSRR, interrupt on completion
+  RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+  DMA1_Channel7->CCR = 0;
+  DMA1_Channel7->CPAR = (uint32_t)&GPIOB->BSRR;
+  NVIC_SetPriority(DMA1_Channel7_IRQn, 1);
+  NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+}
+
+uint16_t dmaSPI::render(uint32_t *buf, const uint32_t *words, uint8_t count)
+{
+  const uint32_t one = mosiMask_ | (sckMask_ << 16);
+  const uint32_t zero = (mosiMask_ | sckMask_) << 16;
+  uint16_t n = 0;
+  for (uint8_t w = 0; w < count; w++) {
+    uint32_t word = words[w];
+    for (uint8_t bit = 0; bit < 32; bit++) {
+      //Clock low with the data bit, then clock high to sample it
+      buf[n++] = (word & 0x80000000UL) ? one : zero;
+      buf[n++] = sckMask_;
+      word <<= 1;
+    }
+    buf[n++] = sckMask_ << 16;
+    buf[n++] = leMask_;
+    buf[n++] = leMask_ << 16;
+  }
+  return n;
+}
+
+void dmaSPI::write(const uint32_t *words, uint8_t count, void (*done)())
+{
+  if (count == 0) {
+    return;
+  }
+  if (count > DMA_SPI_MAX_WORDS) {
+    count = DMA_SPI_MAX_WORDS;
+  }
+  //Render into the buffer not used by the transfer in progress
+  uint32_t *buf = buf_[next_];
+  uint16_t n = render(buf, words, count);
+  next_ ^= 1;
+  wait();
+
+  done_ = done;
+  busy_ = true;
+  DMA1_Channel7->CCR = 0;
+  DMA1->IFCR = DMA_IFCR_CGIF7;
+  DMA1_Channel7->CMAR = (uint32_t)buf;
+  DMA1_Channel7->CNDTR = n;
+  DMA1_Channel7->CCR = DMA_CCR_PL_1 | DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1 |
+                       DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE | DMA_CCR_EN;
+  TIM4->CNT = 0;
+  TIM4->CR1 = TIM_CR1_CEN;
+}
+
+void dmaSPI::writeWord(uint32_t word)
+{
+  write(&word, 1);
+  wait();
+}
+
+void dmaSPI::irq()
+{
+  if (DMA1->ISR & DMA_ISR_TCIF7) {
+    TIM4->CR1 = 0;
+    DMA1_Channel7->CCR = 0;
+    DMA1->IFCR = DMA_IFCR_CGIF7;
+    busy_ = false;
+    if (done_ != NULL) {
+      done_();
+    }
+  }
+}
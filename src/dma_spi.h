@@ -0,0 +1,69 @@
+//
+//  dma_spi.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Non-blocking ADF4351 register writer. The SCK/MOSI/LE edges for a set
+// of register words are rendered into a buffer of GPIOB BSRR values which TIM4 clocks
+// out to the port with DMA1 channel 7. The CPU is free while the words shift out.
+// Two render buffers are used so the next frame can be prepared during a transfer.
+//
+
+#ifndef DMA_SPI_H
+#define DMA_SPI_H
+
+#include <Arduino.h>
+
+#define DMA_SPI_RATE_HZ   4000000UL ///< BSRR writes per second, each clock phase lasts one period
+#define DMA_SPI_MAX_WORDS 6         ///< Register words per transfer
+#define DMA_SPI_STEPS_PER_WORD 67   ///< 32 x (data+SCK low, SCK high), SCK low, LE high, LE low
+
+class dmaSPI
+{
+  public:
+    dmaSPI(uint32_t mosi, uint32_t sck, uint32_t le)
+      : mosi_(mosi), sck_(sck), le_(le) { }
+
+    //Configure the pins, TIM4 and DMA1 channel 7
+    void begin();
+
+    //Render the words (sent in order, MSB first, LE pulse after each) and start the transfer.
+    //Returns once the transfer has started, waiting only if the previous one is still running.
+    //done is called from the DMA interrupt when the last LE pulse has been sent.
+    void write(const uint32_t *words, uint8_t count, void (*done)() = NULL);
+
+    //Single word write that waits for completion
+    void writeWord(uint32_t word);
+
+    //True while a transfer is in progress
+    bool busy() { return busy_; }
+
+    //Wait for the current transfer to finish
+    void wait() { while (busy_) { } }
+
+    //Called from DMA1_Channel7_IRQHandler
+    void irq();
+
+  private:
+    uint16_t render(uint32_t *buf, const uint32_t *words, uint8_t count);
+
+    const uint32_t mosi_;
+    const uint32_t sck_;
+    const uint32_t le_;
+    uint32_t mosiMask_;
+    uint32_t sckMask_;
+    uint32_t leMask_;
+    volatile bool busy_;
+    void (*done_)();
+    uint8_t next_;   ///< render buffer to use for the next write
+    uint32_t buf_[2][DMA_SPI_MAX_WORDS * DMA_SPI_STEPS_PER_WORD];
+};
+
+#endif
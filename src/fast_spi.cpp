@@ -0,0 +1,70 @@
+//
+//  fast_spi.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Bit banged SPI writer for the ADF4351 using direct GPIO BSRR writes.
+// Writing BSRR sets (low half) or resets (high half) pins in a single store, so
+// MOSI and SCK change together without a read-modify-write of ODR.
+//
+
+#include <Arduino.h>
+#include "fast_spi.h"
+
+//Busy wait for at least n cycles, each nop takes one or more cycles
+static inline __attribute__((always_inline)) void spinCycles(uint32_t n)
+{
+  while (n--) {
+    __asm__ volatile ("nop");
+  }
+}
+
+void fastSPI::begin()
+{
+  pinMode(mosi_, OUTPUT);
+  pinMode(sck_, OUTPUT);
+  pinMode(le_, OUTPUT);
+  //MOSI and SCK share GPIOB on the LTDZ board
+  bsrr_ = &digitalPinToPort(sck_)->BSRR;
+  leBsrr_ = &digitalPinToPort(le_)->BSRR;
+  mosiMask_ = digitalPinToBitMask(mosi_);
+  sckMask_ = digitalPinToBitMask(sck_);
+  leMask_ = digitalPinToBitMask(le_);
+  *bsrr_ = (sckMask_ | mosiMask_) << 16; //SCK and MOSI low
+  *leBsrr_ = leMask_ << 16;              //LE low
+}
+
+void fastSPI::writeWord(uint32_t word)
+{
+  const uint32_t clkLow = ADF_NS_TO_CYCLES(ADF_T_CLK_LOW_NS > ADF_T_DATA_SETUP_NS ? ADF_T_CLK_LOW_NS : ADF_T_DATA_SETUP_NS);
+  const uint32_t clkHigh = ADF_NS_TO_CYCLES(ADF_T_CLK_HIGH_NS);
+  const uint32_t mosiSet = mosiMask_;
+  const uint32_t mosiClr = (mosiMask_ | sckMask_) << 16;
+  const uint32_t sck = sckMask_;
+  volatile uint32_t *bsrr = bsrr_;
+
+  for (uint8_t bit = 0; bit < 32; bit++) {
+    //Clock low and next data bit in one store, data is sampled on the rising edge
+    if (word & 0x80000000UL) {
+      *bsrr = mosiSet | (sck << 16);
+    } else {
+      *bsrr = mosiClr;
+    }
+    word <<= 1;
+    spinCycles(clkLow);
+    *bsrr = sck;
+    spinCycles(clkHigh);
+  }
+  *bsrr = sck << 16;
+  spinCycles(ADF_NS_TO_CYCLES(ADF_T_LE_SETUP_NS));
+  *leBsrr_ = leMask_;
+  spinCycles(ADF_NS_TO_CYCLES(ADF_T_LE_PULSE_NS));
+  *leBsrr_ = leMask_ << 16;
+}
@@ -0,0 +1,57 @@
+//
+//  fast_spi.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Bit banged SPI writer for the ADF4351 using direct GPIO BSRR writes.
+// The LTDZ board routes MOSI to PB14 and SCK to PB15, which is swapped relative to
+// the STM32 SPI2 alternate functions, so the hardware SPI peripheral can't be used.
+// Each clock phase is padded to the ADF4351 minimum timings for the current F_CPU.
+//
+
+#ifndef FAST_SPI_H
+#define FAST_SPI_H
+
+#include <Arduino.h>
+
+//ADF4351 serial interface minimum timings (datasheet table 2)
+#define ADF_T_DATA_SETUP_NS  10 ///< t2 DATA to CLK setup
+#define ADF_T_CLK_HIGH_NS    25 ///< t4 CLK high
+#define ADF_T_CLK_LOW_NS     25 ///< t5 CLK low
+#define ADF_T_LE_SETUP_NS    10 ///< t6 CLK to LE setup
+#define ADF_T_LE_PULSE_NS    20 ///< t7 LE pulse width
+
+//Number of CPU cycles covering a time in ns, rounded up
+#define ADF_NS_TO_CYCLES(ns) (((ns) * (F_CPU / 1000000UL) + 999UL) / 1000UL)
+
+class fastSPI
+{
+  public:
+    fastSPI(uint32_t mosi, uint32_t sck, uint32_t le)
+      : mosi_(mosi), sck_(sck), le_(le) { }
+
+    //Configure the pins and look up the port and BSRR bit masks
+    void begin();
+
+    //Shift out a 32 bit word MSB first and pulse LE to latch it
+    void writeWord(uint32_t word);
+
+  private:
+    const uint32_t mosi_;
+    const uint32_t sck_;
+    const uint32_t le_;
+    volatile uint32_t *bsrr_;    ///< BSRR of the MOSI/SCK port
+    volatile uint32_t *leBsrr_;  ///< BSRR of the LE port
+    uint32_t mosiMask_;
+    uint32_t sckMask_;
+    uint32_t leMask_;
+};
+
+#endif
@@ -0,0 +1,142 @@
+//
+//  glide.cpp
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Wall clock frequency glides in fixed point. The time through a glide is a
+// Q0.32 fraction of its length, the exponential curve comes from a 257 entry table with
+// linear interpolation, and q32Mul() scales the frequency span by either.
+//
+
+#include <Arduino.h>
+#include "glide.h"
+#include "mod_math.h"
+
+//(1 - e^(-GLIDE_EXP_TAUS * x)) / (1 - e^(-GLIDE_EXP_TAUS)) * 65535 for x = 0 to 1 in 256 steps
+static const uint16_t expCurve[257] = {
+0x0000,0x04fc,0x09e0,0x0eab,0x135e,0x17fb,0x1c80,0x20ef,
+0x2548,0x298c,0x2dba,0x31d4,0x35d9,0x39cb,0x3da9,0x4174,
+0x452c,0x48d2,0x4c65,0x4fe7,0x5358,0x56b7,0x5a06,0x5d44,
+0x6073,0x6391,0x66a0,0x69a0,0x6c92,0x6f74,0x7248,0x750f,
+0x77c7,0x7a72,0x7d10,0x7fa1,0x8225,0x849d,0x8709,0x8968,
+0x8bbc,0x8e04,0x9041,0x9273,0x949a,0x96b6,0x98c8,0x9ad0,
+0x9cce,0x9ec1,0xa0ab,0xa28c,0xa463,0xa632,0xa7f7,0xa9b3,
+0xab67,0xad13,0xaeb6,0xb051,0xb1e4,0xb36f,0xb4f3,0xb66f,
+0xb7e4,0xb952,0xbab8,0xbc18,0xbd71,0xbec3,0xc00e,0xc154,
+0xc293,0xc3cb,0xc4fe,0xc62b,0xc752,0xc873,0xc98f,0xcaa5,
+0xcbb5,0xccc1,0xcdc7,0xcec9,0xcfc5,0xd0bc,0xd1af,0xd29d,
+0xd386,0xd46b,0xd54b,0xd627,0xd6ff,0xd7d3,0xd8a2,0xd96e,
+0xda35,0xdaf9,0xdbb9,0xdc75,0xdd2e,0xdde3,0xde94,0xdf42,
+0xdfed,0xe094,0xe138,0xe1d9,0xe277,0xe312,0xe3aa,0xe43f,
+0xe4d1,0xe560,0xe5ec,0xe676,0xe6fd,0xe782,0xe803,0xe883,
+0xe900,0xe97a,0xe9f2,0xea68,0xeadc,0xeb4d,0xebbc,0xec29,
+0xec94,0xecfc,0xed63,0xedc8,0xee2b,0xee8c,0xeeeb,0xef48,
+0xefa3,0xeffd,0xf055,0xf0ab,0xf0ff,0xf152,0xf1a3,0xf1f3,
+0xf241,0xf28e,0xf2d9,0xf323,0xf36b,0xf3b2,0xf3f7,0xf43c,
+0xf47e,0xf4c0,0xf500,0xf53f,0xf57d,0xf5ba,0xf5f5,0xf62f,
+0xf669,0xf6a1,0xf6d8,0xf70e,0xf742,0xf776,0xf7a9,0xf7db,
+0xf80c,0xf83c,0xf86b,0xf899,0xf8c6,0xf8f3,0xf91e,0xf949,
+0xf973,0xf99c,0xf9c4,0xf9eb,0xfa12,0xfa38,0xfa5d,0xfa82,
+0xfaa5,0xfac9,0xfaeb,0xfb0d,0xfb2e,0xfb4e,0xfb6e,0xfb8d,
+0xfbac,0xfbca,0xfbe7,0xfc04,0xfc20,0xfc3c,0xfc57,0xfc72,
+0xfc8c,0xfca6,0xfcbf,0xfcd8,0xfcf0,0xfd08,0xfd1f,0xfd36,
+0xfd4c,0xfd62,0xfd78,0xfd8d,0xfda2,0xfdb6,0xfdca,0xfddd,
+0xfdf1,0xfe03,0xfe16,0xfe28,0xfe3a,0xfe4b,0xfe5c,0xfe6d,
+0xfe7d,0xfe8d,0xfe9d,0xfeac,0xfebb,0xfeca,0xfed9,0xfee7,
+0xfef5,0xff03,0xff10,0xff1e,0xff2b,0xff37,0xff44,0xff50,
+0xff5c,0xff68,0xff73,0xff7e,0xff8a,0xff94,0xff9f,0xffaa,
+0xffb4,0xffbe,0xffc8,0xffd1,0xffdb,0xffe4,0xffed,0xfff6,
+0xffff
+};
+
+static const char *const modeNames[] = { "Off", "Linear", "Exponential", "Constant slew" };
+
+bool Glide::set(uint8_t mode, uint32_t value)
+{
+  if (mode > GLIDE_SLEW || ((mode == GLIDE_LINEAR || mode == GLIDE_EXP) && value > GLIDE_TIME_MAX_MS)) {
+    return false;
+  }
+  if (value == 0) {
+    mode = GLIDE_OFF;
+  }
+  mode_ = mode;
+  value_ = value;
+  return true;
+}
+
+const char *Glide::name(uint8_t mode)
+{
+  return mode <= GLIDE_SLEW ? modeNames[mode] : "";
+}
+
+void Glide::start(uint64_t from, uint64_t to, uint32_t now_us)
+{
+  from_ = from;
+  to_ = to;
+  last_us_ = now_us;
+  elapsed_us_ = 0;
+  if (mode_ == GLIDE_SLEW) {
+    //Round up so the rate is never exceeded
+    uint64_t distance = to > from ? to - from : from - to;
+    duration_us_ = (distance * 1000000ULL + value_ - 1) / value_;
+  } else {
+    duration_us_ = (uint64_t)value_ * 1000;
+  }
+  finished_ = false;
+  curve_ = mode_;
+  running_ = mode_ != GLIDE_OFF;
+}
+
+uint64_t Glide::stop()
+{
+  running_ = false;
+  return to_;
+}
+
+uint64_t Glide::at(uint32_t now_us)
+{
+  if (!running_) {
+    return to_;
+  }
+  elapsed_us_ += now_us - last_us_;
+  last_us_ = now_us;
+  if (elapsed_us_ >= duration_us_) {
+    achieved_us_ = elapsed_us_;
+    running_ = false;
+    finished_ = true;
+    return to_;
+  }
+
+  //Fraction of the glide length in Q0.32, dropping low bits of glides over 71 minutes
+  uint64_t elapsed = elapsed_us_;
+  uint64_t duration = duration_us_;
+  while (duration >> 32) {
+    elapsed >>= 1;
+    duration >>= 1;
+  }
+  uint32_t position = (uint32_t)((elapsed << 32) / duration);
+
+  if (curve_ == GLIDE_EXP) {
+    uint16_t i = position >> 24;
+    uint32_t fraction = (position >> 8) & 0xFFFF;
+    uint32_t curve = expCurve[i] + (((uint32_t)(expCurve[i + 1] - expCurve[i]) * fraction) >> 16);
+    position = curve * 65537UL; //Q0.16 to Q0.32, 0xFFFF to 0xFFFFFFFF
+  }
+  return from_ + q32Mul((int64_t)(to_ - from_), position);
+}
+
+bool Glide::finished()
+{
+  if (!finished_) {
+    return false;
+  }
+  finished_ = false;
+  return true;
+}
@@ -0,0 +1,79 @@
+//
+//  glide.h
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Wall clock frequency glides. The position of a glide is worked out from
+// the microseconds since it started rather than the number of steps taken, so it reaches
+// the setpoint at the requested time however often at() is called. Linear and exponential
+// glides take a fixed time, a constant slew glide moves at a fixed rate in Hz per second.
+//
+
+#ifndef GLIDE_H
+#define GLIDE_H
+
+#include <Arduino.h>
+
+#define GLIDE_OFF      0
+#define GLIDE_LINEAR   1 ///< G, straight line taking the set time
+#define GLIDE_EXP      2 ///< J, exponential approach with a time constant of 1/GLIDE_EXP_TAUS of the set time
+#define GLIDE_SLEW     3 ///< K, straight line at the set rate in Hz per second
+
+#define GLIDE_EXP_TAUS    5      ///< time constants in a J glide, scaled so the last one ends on the setpoint
+#define GLIDE_TIME_MAX_MS 600000 ///< longest G and J glide
+
+class Glide
+{
+  public:
+    Glide()
+      : mode_(GLIDE_OFF), value_(0), curve_(GLIDE_OFF), running_(false), finished_(false),
+        from_(0), to_(0), last_us_(0), elapsed_us_(0), duration_us_(0), achieved_us_(0)
+      {}
+
+    //Set the mode with a time in ms (G, J) or a rate in Hz per second (K),
+    //0 turns glides off. Returns false if out of range. A running glide carries on
+    //with the curve and length it started with, stop() ends it
+    bool set(uint8_t mode, uint32_t value);
+    uint8_t mode() const { return mode_; }
+    uint32_t value() const { return value_; }
+    bool active() const { return mode_ != GLIDE_OFF; }
+    static const char *name(uint8_t mode);
+
+    //Start gliding from one frequency to another at now_us, replacing any glide in progress
+    void start(uint64_t from, uint64_t to, uint32_t now_us);
+    //Frequency at now_us, the end frequency once the glide is over.
+    //Call at least once every 71 minutes while running to follow micros() wrapping
+    uint64_t at(uint32_t now_us);
+    bool running() const { return running_; }
+    //End a running glide now, returns the end frequency
+    uint64_t stop();
+    //True once after a glide has reached its end frequency
+    bool finished();
+
+    //Requested and achieved length of the last finished glide in us.
+    //Achieved is the time of the first at() call that returned the end frequency
+    uint64_t requestedUs() const { return duration_us_; }
+    uint64_t achievedUs() const { return achieved_us_; }
+
+  private:
+    uint8_t mode_;
+    uint32_t value_;
+    uint8_t curve_; ///< mode of the running glide
+    bool running_;
+    bool finished_;
+    uint64_t from_;
+    uint64_t to_;
+    uint32_t last_us_;
+    uint64_t elapsed_us_;
+    uint64_t duration_us_;
+    uint64_t achieved_us_;
+};
+
+#endif
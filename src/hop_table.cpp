@@ -0,0 +1,278 @@
+//
+//  hop_table.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Frequency hop list played from the HOP_TRIGGER_TIMER input capture
+// interrupt. The timer runs free at the CPU clock, so the capture register holds the
+// tick of the edge and the tick count read after the R0 latch gives the latency.
+//
+
+#include <Arduino.h>
+#include "brd_ltdz_stm32f103cb.h"
+#include "hop_table.h"
+#include "adf4351_fields.h"
+
+static HardwareTimer *hopTimer = NULL;
+static HopTable *activeHop = NULL;
+
+static void hopTriggerISR()
+{
+  activeHop->captured();
+}
+
+void HopTable::clear()
+{
+  disarm();
+  table_.clear();
+  table_.user = REG_TABLE_HOP;
+  count_ = 0;
+  memset(apart_, 0, sizeof(apart_));
+  apartCount_ = 0;
+}
+
+bool HopTable::add(uint64_t freq, int8_t power)
+{
+  if (table_.user != REG_TABLE_HOP) {
+    clear(); //The table was reused by the modulation or a sweep
+  }
+  if (count_ >= HOP_MAX_ENTRIES) {
+    return false;
+  }
+  PLLPlan p;
+  if (vfo_.plan(freq, p) != 0 || !table_.add(vfo_, p)) {
+    return false;
+  }
+  if (power < 0) {
+    power = HOP_POWER_KEEP;
+  } else if (power > 3) {
+    power = 3;
+  }
+  power_[count_++] = power;
+  return true;
+}
+
+bool HopTable::arm(uint16_t index)
+{
+  if (count_ == 0 || table_.user != REG_TABLE_HOP || table_.size() != count_) {
+    return false;
+  }
+  disarm();
+  activeHop = this;
+  hops = 0;
+  resetLatency();
+  play(index < count_ ? index : 0);
+  if (hopTimer == NULL) {
+    hopTimer = new HardwareTimer(HOP_TRIGGER_TIMER);
+  }
+  //Free running at the CPU clock, 16 bit wrap (910 us) is far above any latency
+  hopTimer->pause();
+  hopTimer->setPrescaleFactor(1);
+  hopTimer->setOverflow(0x10000, TICK_FORMAT);
+  hopTimer->setMode(HOP_TRIGGER_CHANNEL, TIMER_INPUT_CAPTURE_RISING, HOP_TRIGGER_PIN);
+  pinMode(HOP_TRIGGER_PIN, INPUT_PULLUP);
+  hopTimer->attachInterrupt(HOP_TRIGGER_CHANNEL, hopTriggerISR);
+  hopTimer->setInterruptPriority(1, 0);
+  armed_ = true;
+  hopTimer->resume();
+  return true;
+}
+
+void HopTable::disarm()
+{
+  if (armed_) {
+    hopTimer->pause();
+    hopTimer->detachInterrupt(HOP_TRIGGER_CHANNEL);
+    armed_ = false;
+  }
+}
+
+//Returns the number of registers written
+uint8_t HopTable::play(uint16_t index)
+{
+  if (power_[index] != HOP_POWER_KEEP) {
+    Adf::OutputPower::set(vfo_.R, power_[index]);
+  }
+  table_.play(vfo_, index);
+  next = index + 1 < count_ ? index + 1 : 0;
+  uint8_t mask = vfo_.lastWriteMask;
+  uint8_t regs = 0;
+  while (mask != 0) {
+    regs += mask & 1;
+    mask >>= 1;
+  }
+  return regs;
+}
+
+static uint32_t gcd32(uint32_t a, uint32_t b)
+{
+  while (b != 0) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+void HopTable::setApart(uint16_t index)
+{
+  apart_[index >> 3] |= 1 << (index & 7);
+  apartCount_++;
+}
+
+uint16_t HopTable::share()
+{
+  if (count_ == 0 || table_.user != REG_TABLE_HOP || table_.size() != count_) {
+    return 0;
+  }
+  Reg regs[6];
+  //The most used output divider, with the 8/9 prescaler if any entry of it needs it
+  uint16_t bands[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  for (uint16_t i = 0; i < count_; i++) {
+    table_.get(i, regs);
+    bands[Adf::RFDivSel::get(regs)]++;
+  }
+  uint8_t divsel = 0;
+  for (uint8_t d = 1; d < 8; d++) {
+    if (bands[d] > bands[divsel]) {
+      divsel = d;
+    }
+  }
+  uint8_t prescaler = 0;
+  for (uint16_t i = 0; i < count_; i++) {
+    table_.get(i, regs);
+    if (Adf::RFDivSel::get(regs) == divsel && Adf::Prescaler::get(regs) != 0) {
+      prescaler = 1;
+    }
+  }
+
+  //MOD is the least common multiple of the reduced FRAC/MOD denominators
+  memset(apart_, 0, sizeof(apart_));
+  apartCount_ = 0;
+  uint32_t mod = 1;
+  for (uint16_t i = 0; i < count_; i++) {
+    table_.get(i, regs);
+    uint32_t frac = Adf::FracValue::get(regs);
+    uint32_t m = Adf::ModValue::get(regs);
+    uint32_t den = m / gcd32(frac, m);
+    uint32_t lcm = mod / gcd32(mod, den) * den;
+    if (Adf::RFDivSel::get(regs) != divsel || (prescaler != 0 && Adf::IntValue::get(regs) < 75) ||
+        lcm > ADF_MOD_MAX) {
+      setApart(i);
+      continue;
+    }
+    mod = lcm;
+  }
+  if (mod < 2) {
+    mod = 2;
+  }
+
+  PLLPlan p;
+  p.freq = 0;
+  p.cfreq = 0;
+  p.ferr_mHz = 0;
+  p.Mod = mod;
+  p.RfDivSel = divsel;
+  p.Prescaler = prescaler;
+  p.FracN = 1; //FRAC 0 entries stay in frac-n mode so R2 and R3 do not change
+  for (uint16_t i = 0; i < count_; i++) {
+    if (apart(i)) {
+      continue;
+    }
+    table_.get(i, regs);
+    uint32_t frac = Adf::FracValue::get(regs);
+    uint32_t m = Adf::ModValue::get(regs);
+    uint32_t g = gcd32(frac, m);
+    p.N_Int = Adf::IntValue::get(regs);
+    p.Frac = frac / g * (mod / (m / g));
+    if (!table_.set(vfo_, p, i)) {
+      setApart(i); //Palette full, keeps its own plan
+    }
+  }
+  return mod;
+}
+
+void HopTable::trigger()
+{
+  play(next);
+  hops++;
+}
+
+void HopTable::captured()
+{
+  uint8_t regs = play(next);
+  uint16_t latch = HOP_TRIGGER_TIMER->CNT;
+  uint16_t edge = hopTimer->getCaptureCompare(HOP_TRIGGER_CHANNEL, TICK_FORMAT);
+  uint32_t cycles = (uint16_t)(latch - edge);
+  hops++;
+  if (regs == 0 || regs > HOP_REGS_MAX) {
+    return; //Same words as the entry before, nothing was latched
+  }
+  cyclesLast_ = cycles;
+  regsLast_ = regs;
+  if (cycles < cyclesMin_[regs - 1]) {
+    cyclesMin_[regs - 1] = cycles;
+  }
+  if (cycles > cyclesMax_[regs - 1]) {
+    cyclesMax_[regs - 1] = cycles;
+  }
+  timed_[regs - 1]++;
+}
+
+void HopTable::lock()
+{
+  NVIC_DisableIRQ(HOP_TRIGGER_IRQn);
+  __DSB();
+  __ISB();
+}
+
+void HopTable::unlock()
+{
+  NVIC_EnableIRQ(HOP_TRIGGER_IRQn);
+}
+
+void HopTable::resetLatency()
+{
+  for (uint8_t i = 0; i < HOP_REGS_MAX; i++) {
+    cyclesMin_[i] = 0xFFFFFFFFUL;
+    cyclesMax_[i] = 0;
+    timed_[i] = 0;
+  }
+  cyclesLast_ = 0;
+  regsLast_ = 0;
+}
+
+static uint32_t cyclesToNs(uint32_t cycles)
+{
+  return (uint64_t)cycles * 1000ULL / (F_CPU / 1000000UL);
+}
+
+uint32_t HopTable::latencyMin(uint8_t regs) const
+{
+  if (regs == 0 || regs > HOP_REGS_MAX || timed_[regs - 1] == 0) {
+    return 0;
+  }
+  return cyclesToNs(cyclesMin_[regs - 1]);
+}
+
+uint32_t HopTable::latencyMax(uint8_t regs) const
+{
+  return regs == 0 || regs > HOP_REGS_MAX ? 0 : cyclesToNs(cyclesMax_[regs - 1]);
+}
+
+uint32_t HopTable::latencyHops(uint8_t regs) const
+{
+  return regs == 0 || regs > HOP_REGS_MAX ? 0 : timed_[regs - 1];
+}
+
+uint32_t HopTable::latencyLast() const
+{
+  return cyclesToNs(cyclesLast_);
+}
@@ -0,0 +1,113 @@
+//
+//  hop_table.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Frequency hop list played on an external trigger. Each frequency is
+// solved into a RegTable when it is added, optionally with its own output power, and a
+// rising edge on HOP_TRIGGER_PIN moves to the next entry from the input capture
+// interrupt of HOP_TRIGGER_TIMER. Only the registers that differ from the previous entry
+// are written, ending with the R0 latch. An entry that only changes R0 costs a single
+// register write.
+//
+// The latency is the time from the captured edge to the R0 latch in timer ticks (one
+// per CPU cycle), so it includes the interrupt entry and the core's timer dispatch. It
+// is kept per number of registers written, as each register is a fixed SPI write. The
+// rest of the path is fixed except for interrupts that run first or preempt it (SysTick
+// and any other at priority 0 or 1) and code that briefly runs with interrupts off
+// (LockDetect, the profiler, ADF4351::syncFromRegisters(), under 1 us each), which can
+// only add to the figure, so max shows the worst case seen rather than a bound. With
+// USE_DMA_SPI the figure ends when the words are queued, not at the latch.
+// share() re-encodes the list with a common output divider, prescaler and MOD so that
+// every hop between shared entries is a single R0 write.
+//
+
+#ifndef HOP_TABLE_H
+#define HOP_TABLE_H
+
+#include <Arduino.h>
+#include "adf4351.h"
+#include "reg_table.h"
+
+#define HOP_MAX_ENTRIES 512 ///< Maximum hop list length
+#define HOP_POWER_KEEP  -1  ///< entry power that leaves the output power unchanged
+#define HOP_REGS_MAX    6   ///< latency is kept for hops writing 1 to HOP_REGS_MAX registers
+
+class HopTable
+{
+  public:
+    HopTable(ADF4351 &vfo, RegTable &table)
+      : hops(0), next(0), vfo_(vfo), table_(table), count_(0), apartCount_(0), armed_(false)
+      { resetLatency(); }
+
+    //Empty the list and take over the table
+    void clear();
+
+    //Solve freq and append it with power 0-3 or HOP_POWER_KEEP,
+    //returns false if it can not be solved or the list is full
+    bool add(uint64_t freq, int8_t power);
+
+    //Write entry index now and hop to the following entries on each trigger edge,
+    //returns false if the list is empty or the table has been reused since
+    bool arm(uint16_t index);
+    void disarm();
+    bool armed() const { return armed_; }
+
+    //Software trigger, the same as an edge on HOP_TRIGGER_PIN but not timed
+    void trigger();
+    //Input capture interrupt handler, hops and times the hop from the captured edge
+    void captured();
+
+    //Re-encode the list with the most used output divider, one prescaler and the least
+    //common multiple of the entry FRAC/MOD denominators as MOD, so the generated
+    //frequencies are unchanged. Entries in another divider band, or whose denominator
+    //would take MOD over ADF_MOD_MAX, keep their own plan and are marked apart().
+    //Returns the shared MOD, 0 if the list is empty or the table has been reused
+    uint16_t share();
+    bool apart(uint16_t index) const { return (apart_[index >> 3] >> (index & 7)) & 1; }
+    uint16_t apartCount() const { return apartCount_; }
+
+    //Hold off the trigger interrupt while the main loop writes the ADF4351 itself
+    void lock();
+    void unlock();
+
+    uint16_t size() const { return count_; }
+    void resetLatency();
+    //Trigger edge to R0 latch time in ns since arm() of the hops that wrote regs
+    //registers (1 to HOP_REGS_MAX), and how many there were
+    uint32_t latencyMin(uint8_t regs) const;
+    uint32_t latencyMax(uint8_t regs) const;
+    uint32_t latencyHops(uint8_t regs) const;
+    //Time of the last timed hop and the number of registers it wrote
+    uint32_t latencyLast() const;
+    uint8_t latencyLastRegs() const { return regsLast_; }
+
+    volatile uint32_t hops ;  ///< triggers handled since arm()
+    volatile uint16_t next ;  ///< entry written on the next trigger
+
+  private:
+    uint8_t play(uint16_t index);
+    void setApart(uint16_t index);
+
+    ADF4351 &vfo_;
+    RegTable &table_;
+    int8_t power_[HOP_MAX_ENTRIES];
+    uint16_t count_;
+    uint8_t apart_[HOP_MAX_ENTRIES / 8]; ///< entries left out of the shared plan
+    uint16_t apartCount_;
+    volatile bool armed_;
+    volatile uint32_t cyclesMin_[HOP_REGS_MAX];
+    volatile uint32_t cyclesMax_[HOP_REGS_MAX];
+    volatile uint32_t timed_[HOP_REGS_MAX];
+    volatile uint32_t cyclesLast_;
+    volatile uint8_t regsLast_;
+};
+
+#endif
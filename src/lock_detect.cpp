@@ -0,0 +1,191 @@
+//
+//  lock_detect.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Lock time measurement from the R0 latch to the PIN_LD rising edge.
+// latched() may run from the main loop or any interrupt that writes the ADF4351, so it
+// masks interrupts while it replaces the pending measurement.
+//
+
+#include <Arduino.h>
+#include "brd_ltdz_stm32f103cb.h"
+#include "lock_detect.h"
+#include "profiler.h"
+
+#define CYCLES_PER_US (F_CPU / 1000000UL)
+
+static LockDetect *activeLock = NULL;
+
+static void lockWriteComplete()
+{
+  activeLock->latched();
+}
+
+static void lockEdgeISR()
+{
+  activeLock->edge();
+}
+
+void LockDetect::begin()
+{
+  activeLock = this;
+  vfo_.onWriteComplete = lockWriteComplete;
+  pinMode(PIN_LD, INPUT);
+  attachInterrupt(digitalPinToInterrupt(PIN_LD), lockEdgeISR, RISING);
+}
+
+void LockDetect::latched()
+{
+  if ((vfo_.lastWriteMask & 1) == 0) {
+    return; //R0 not written, the device keeps its frequency
+  }
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (state_ == LOCK_PENDING) {
+    superseded++;
+  }
+  latchCycles_ = DWT->CYCCNT;
+  state_ = LOCK_PENDING;
+  __set_PRIMASK(primask);
+}
+
+void LockDetect::edge()
+{
+  uint32_t now = DWT->CYCCNT;
+  if (state_ != LOCK_PENDING) {
+    return;
+  }
+  uint32_t cycles = now - latchCycles_;
+  lastCycles_ = cycles;
+  if (cycles < minCycles_) {
+    minCycles_ = cycles;
+  }
+  if (cycles > maxCycles_) {
+    maxCycles_ = cycles;
+  }
+  sumCycles_ += cycles;
+  profiler.record(PROF_LOCK, cycles);
+  uint32_t us = cycles / CYCLES_PER_US;
+  uint8_t bin = 0;
+  while (us != 0 && bin < LOCK_HIST_BINS - 1) {
+    us >>= 1;
+    bin++;
+  }
+  hist[bin]++;
+  locks++;
+  state_ = LOCK_LOCKED;
+  if (onLock != NULL) {
+    onLock();
+  }
+}
+
+void LockDetect::service()
+{
+  if (state_ != LOCK_PENDING) {
+    return;
+  }
+  noInterrupts();
+  if (state_ == LOCK_PENDING && DWT->CYCCNT - latchCycles_ > LOCK_WINDOW_US * CYCLES_PER_US) {
+    timeouts++;
+    state_ = LOCK_TIMEOUT;
+  }
+  interrupts();
+}
+
+uint32_t LockDetect::lastUs() const
+{
+  return lastCycles_ / CYCLES_PER_US;
+}
+
+bool LockDetect::waitStart(uint32_t timeout_us)
+{
+  if (timeout_us < 1 || timeout_us > LOCK_WAIT_MAX_US) {
+    return false;
+  }
+  waitStart_ = DWT->CYCCNT;
+  waitCycles_ = timeout_us * CYCLES_PER_US;
+  waiting_ = true;
+  return true;
+}
+
+bool LockDetect::waitDone(uint8_t &result)
+{
+  if (!waiting_) {
+    return false;
+  }
+  service();
+  if (state_ == LOCK_PENDING) {
+    if (DWT->CYCCNT - waitStart_ <= waitCycles_) {
+      return false;
+    }
+    result = LOCK_TIMEOUT;
+  } else {
+    //A retune that timed out may still lock later, so check the pin as well
+    result = (state_ == LOCK_LOCKED || digitalRead(PIN_LD) == HIGH) ? LOCK_LOCKED : LOCK_TIMEOUT;
+  }
+  waiting_ = false;
+  return true;
+}
+
+uint8_t LockDetect::wait(uint32_t timeout_us)
+{
+  uint8_t result = LOCK_TIMEOUT;
+  if (waitStart(timeout_us)) {
+    while (!waitDone(result)) {
+    }
+  }
+  return result;
+}
+
+void LockDetect::lock()
+{
+  NVIC_DisableIRQ(LOCK_DETECT_IRQn);
+  __DSB();
+  __ISB();
+}
+
+void LockDetect::unlock()
+{
+  NVIC_EnableIRQ(LOCK_DETECT_IRQn);
+}
+
+void LockDetect::resetStats()
+{
+  locks = 0;
+  timeouts = 0;
+  superseded = 0;
+  for (uint8_t i = 0; i < LOCK_HIST_BINS; i++) {
+    hist[i] = 0;
+  }
+  minCycles_ = 0xFFFFFFFFUL;
+  maxCycles_ = 0;
+  sumCycles_ = 0;
+}
+
+uint32_t LockDetect::minUs() const
+{
+  return locks == 0 ? 0 : minCycles_ / CYCLES_PER_US;
+}
+
+uint32_t LockDetect::avgUs() const
+{
+  return locks == 0 ? 0 : (uint32_t)(sumCycles_ / locks / CYCLES_PER_US);
+}
+
+uint32_t LockDetect::maxUs() const
+{
+  return maxCycles_ / CYCLES_PER_US;
+}
+
+uint32_t LockDetect::binUs(uint8_t n)
+{
+  return n == 0 ? 0 : 1UL << (n - 1);
+}
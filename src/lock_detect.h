@@ -0,0 +1,100 @@
+//
+//  lock_detect.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Lock time measurement for every retune. The ADF4351 write complete
+// callback stamps the DWT cycle counter whenever R0 is latched (a retune always starts a
+// VCO band select, so lock detect drops), and the rising edge of PIN_LD stamps it again
+// from the EXTI interrupt. The difference feeds min/avg/max statistics and a log2
+// microsecond histogram, and drives a blocking or asynchronous wait-for-lock.
+//
+
+#ifndef LOCK_DETECT_H
+#define LOCK_DETECT_H
+
+#include <Arduino.h>
+#include "adf4351.h"
+
+#define LOCK_HIST_BINS   16      ///< bin n counts lock times of 2^(n-1) to 2^n-1 us, the last bin is open
+#define LOCK_WINDOW_US   10000   ///< a retune with no lock edge within this is counted as a timeout
+#define LOCK_WAIT_MAX_US 1000000 ///< longest wait accepted by waitStart()
+
+#define LOCK_IDLE    0 ///< no retune since begin()
+#define LOCK_PENDING 1 ///< R0 latched, waiting for the lock detect edge
+#define LOCK_LOCKED  2 ///< lock detect edge seen
+#define LOCK_TIMEOUT 3 ///< no lock detect edge in time
+
+class LockDetect
+{
+  public:
+    LockDetect(ADF4351 &vfo)
+      : onLock(NULL), vfo_(vfo), state_(LOCK_IDLE), waiting_(false), latchCycles_(0), lastCycles_(0)
+      { resetStats(); }
+
+    //Hook the ADF4351 write complete callback and the PIN_LD edge interrupt
+    void begin();
+
+    //Write complete callback, starts a measurement when R0 was latched
+    void latched();
+    //PIN_LD rising edge interrupt handler
+    void edge();
+    //Count a retune that has not locked within LOCK_WINDOW_US as a timeout
+    void service();
+
+    //LOCK_ state of the last retune
+    uint8_t state() const { return state_; }
+    //DWT->CYCCNT when R0 of the last retune was latched
+    uint32_t latchCycles() const { return latchCycles_; }
+    //Lock time of the last locked retune in us
+    uint32_t lastUs() const;
+
+    //Start an asynchronous wait (1 to LOCK_WAIT_MAX_US) for the last retune to lock,
+    //returns false if out of range
+    bool waitStart(uint32_t timeout_us);
+    bool waiting() const { return waiting_; }
+    //True once when the wait ends, result is LOCK_LOCKED or LOCK_TIMEOUT
+    bool waitDone(uint8_t &result);
+    //Blocking wait, returns LOCK_LOCKED or LOCK_TIMEOUT (also when out of range)
+    uint8_t wait(uint32_t timeout_us);
+
+    //Hold off the lock detect interrupt while the statistics are read
+    void lock();
+    void unlock();
+
+    void resetStats();
+    //Lock time statistics in us, 0 until a retune has locked
+    uint32_t minUs() const;
+    uint32_t avgUs() const;
+    uint32_t maxUs() const;
+    //Lowest lock time counted by histogram bin n in us
+    static uint32_t binUs(uint8_t n);
+
+    volatile uint32_t locks ;      ///< retunes that locked
+    volatile uint32_t timeouts ;   ///< retunes with no lock edge within LOCK_WINDOW_US
+    volatile uint32_t superseded ; ///< retunes replaced by the next one before locking
+    volatile uint32_t hist[LOCK_HIST_BINS] ;
+
+    void (*onLock)(); ///< called from the edge interrupt when the last retune locks
+
+  private:
+    ADF4351 &vfo_;
+    volatile uint8_t state_;
+    bool waiting_;
+    uint32_t waitStart_;
+    uint32_t waitCycles_;
+    volatile uint32_t latchCycles_;
+    volatile uint32_t lastCycles_;
+    volatile uint32_t minCycles_;
+    volatile uint32_t maxCycles_;
+    volatile uint64_t sumCycles_;
+};
+
+#endif
@@ -28,6 +28,19 @@
 #include <math.h>
 #include "sine_16bit_2048.h"
 #include "morse_code.h"
+#include "reg_table.h"
+#include "mod_scheduler.h"
+#include "custom_wave.h"
+#include "binary_protocol.h"
+#include "command_parser.h"
+#include "uart_dma.h"
+#include "sweep.h"
+#include "hop_table.h"
+#include "lock_detect.h"
+#include "profiler.h"
+#include "mod_math.h"
+#include "glide.h"
+#include "mod_graph.h"
 
 #include "usbd_if.c" //Arduino USB detatch
 
@@ -44,10 +57,8 @@ int32_t linearRamp=0;
 int32_t sineWave=0;
 int32_t triangle=0;
 int32_t randomMod=0;
+int32_t customDepth=0;
 int32_t randomDither=0;
-int32_t exp_glide=0;
-int32_t constant_glide=0;
-int32_t glide=0;
 bool lock_enable=false;
 
 
@@ -60,6 +71,10 @@ void setup()
   delay(10);
   Serial_print("Adf4351 demo v") ;
   Serial_println(SWVERSION) ;
+  //DWT cycle counter for the retune profile (QP), lock timing (QL) and parse timing (I)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
   delay(10); 
 }
 
@@ -96,17 +111,69 @@ void setupdds()
 }
 
 
-uint16_t freq_loop=0;
-uint32_t last_f=102500000; 
-uint32_t setpoint_freq=last_f;
-uint32_t startpoint_freq=last_f;  
-uint32_t current_freq=last_f; 
+//LFO phase accumulator, one cycle is 2^32. The top 11 bits index sin2048[]
+//and the next 16 bits interpolate between neighbouring entries
+#define LFO_INDEX_SHIFT 21
+//lfoTable holds REG_TABLE_SIZE (1024) phase bins of 2^22
+#define LFO_TABLE_SHIFT 22
+#define LFO_RATE_MAX_MHZ 10000000 ///< 10 kHz
+uint32_t lfo_phase=0;
+uint32_t lfo_rate_mHz=0; //0 = advance mod_speed sine table entries per step
+unsigned long lfo_last_us=0;
+uint64_t last_f=102500000; 
+uint64_t setpoint_freq=last_f;
+uint64_t current_freq=last_f; 
 uint16_t wpm=20;
-double freq_step=1;
-bool calc_freq_step=false;
 bool modulation_enable;
-unsigned long currentTime=micros();
-unsigned long startTime=currentTime;
+uint32_t parse_cycles=0; //DWT cycles taken to tokenize the last command line
+
+//Pre-solved register words for one S, O or L modulation cycle, one entry per phase bin
+RegTable lfoTable;
+bool lfo_table_valid=false;
+bool lfo_playing=false;
+//LFO settings the table was solved for
+uint64_t lfo_table_f=0;
+int32_t lfo_table_ramp=0;
+int32_t lfo_table_sine=0;
+int32_t lfo_table_triangle=0;
+int32_t lfo_table_custom=0;
+uint16_t lfo_table_wave=0;
+
+//Fixed rate modulation output, stopped (free running) until set with the U command
+ModScheduler modScheduler(vfo, lfoTable);
+
+//Command parser state for one serial port, so USB and UART hosts can issue commands concurrently
+struct CommandSession
+{
+  uint8_t port;          ///< SERIAL_PORT_ the session reads from and replies to
+  bool echo;             ///< echo received text back (TE command)
+  CommandLine line;
+  BinaryProtocol binary;
+};
+
+//Lock time of every retune (QL command)
+LockDetect lockDetect(vfo);
+uint8_t lock_port=SERIAL_PORT_ALL; //Port the asynchronous wait-for-lock report goes to
+
+//Stepped sweep (FS command), shares lfoTable with the modulation as RAM is short
+Sweep sweep(vfo, lfoTable, lockDetect);
+uint8_t sweep_port=SERIAL_PORT_ALL; //Port the sweep report goes to
+
+//Externally triggered hop list (N command), also in lfoTable
+HopTable hop(vfo, lfoTable);
+
+//Wall clock glide to each new setpoint (G, J and K commands)
+Glide glide;
+uint8_t glide_port=SERIAL_PORT_ALL; //Port the glide report goes to
+bool glide_report=false; //Report when the glide ends, only for F setpoints
+unsigned long glide_step_us=0; //Time of the last modulation step, LFO and Z setpoints glide from here
+
+//Extra LFO slots summed with the main LFO (XM command)
+int64_t lfoOffset(uint8_t shape, uint32_t phase, int32_t depth);
+ModGraph modGraph(lfoOffset);
+
+CommandSession sessions[] = { {SERIAL_PORT_USB, true}, {SERIAL_PORT_UART, true} };
+CommandSession *session = &sessions[0]; ///< session of the running command
 
 void enableRF() {
     vfo.enable(); // Code to enable the ADF4351 RF
@@ -116,409 +183,1064 @@ void disableRF() {
     vfo.disable(); // Code to disable the ADF4351 RF
 }
 
-void processSerialInput()
+//Offset of a ramp, sinewave, custom waveform or triangle of depth Hz at LFO phase
+int64_t lfoOffset(uint8_t shape, uint32_t phase, int32_t depth)
+{
+  if(shape==MOD_SHAPE_RAMP){
+    return q32Scale(phase, depth);
+  } else if(shape==MOD_SHAPE_SINE){
+    //Linear interpolation, sample is the sine value scaled to 0-2^32
+    uint32_t index=phase>>LFO_INDEX_SHIFT;
+    int32_t frac=(phase>>(LFO_INDEX_SHIFT-16))&0xFFFF;
+    int32_t s0=sin2048[index];
+    int32_t s1=sin2048[(index+1)&((1UL<<(32-LFO_INDEX_SHIFT))-1)];
+    uint32_t sample=((uint32_t)s0<<16)+(s1-s0)*frac;
+    return q32Scale(sample, depth);
+  } else if(shape==MOD_SHAPE_CUSTOM){
+    return customWaveSize==0 ? 0 : q31Scale(customWaveSample(phase), depth);
+  } else {
+    return triangleOffset(phase, depth);
+  }
+}
+
+//Setpoint of the linear ramp, sinewave, custom waveform or triangle modulation at LFO phase
+uint64_t lfoSetpoint(uint32_t phase)
+{
+  if(linearRamp!=0){
+    return last_f+lfoOffset(MOD_SHAPE_RAMP, phase, linearRamp);
+  } else if(sineWave!=0){
+    return last_f+lfoOffset(MOD_SHAPE_SINE, phase, sineWave);
+  } else if(customDepth!=0){
+    return last_f+lfoOffset(MOD_SHAPE_CUSTOM, phase, customDepth);
+  } else {
+    return last_f+lfoOffset(MOD_SHAPE_TRIANGLE, phase, triangle);
+  }
+}
+
+//Returns true if the modulation can be played from lfoTable, solving the whole
+//cycle the first time the S, O, L, C or F settings are used. Only steps that are whole
+//phase bins can use the table, finer steps are interpolated and solved as they are played.
+bool lfoTableReady(uint32_t step)
+{
+  if((linearRamp==0 && sineWave==0 && triangle==0 && customDepth==0) || glide.active() || randomDither!=0 || modGraph.active()){
+    return false; //Glides and dither depend on the previous frequency, XM slots have their own rates
+  }
+  if((step & ((1UL<<LFO_TABLE_SHIFT)-1))!=0){
+    return false;
+  }
+  if(lfoTable.user==REG_TABLE_LFO && lfo_table_f==last_f && lfo_table_ramp==linearRamp && lfo_table_sine==sineWave &&
+     lfo_table_triangle==triangle && lfo_table_custom==customDepth && lfo_table_wave==customWaveId){
+    return lfo_table_valid;
+  }
+  lfo_table_f=last_f;
+  lfo_table_ramp=linearRamp;
+  lfo_table_sine=sineWave;
+  lfo_table_triangle=triangle;
+  lfo_table_custom=customDepth;
+  lfo_table_wave=customWaveId;
+  lfo_table_valid=false;
+  modScheduler.flush(); //Queued frames may refer to the old table
+  lfoTable.clear();
+  lfoTable.user=REG_TABLE_LFO;
+  for(uint32_t bin=0; bin<(1UL<<(32-LFO_TABLE_SHIFT)); bin++){
+    PLLPlan p;
+    if(vfo.plan(lfoSetpoint(bin<<LFO_TABLE_SHIFT), p)!=0 || !lfoTable.add(vfo, p)){
+      lfoTable.clear();
+      return false;
+    }
+  }
+  lfo_table_valid=true;
+  return true;
+}
+
+//FS<start>,<stop>,<step>,<dwell us>[,<lock gate 0/1>[,<repeat 0/1>]] solves and starts a sweep,
+//FS on its own stops it
+void sweepCommand(const CmdArgs &args)
+{
+  int64_t v[6]={0,0,0,0,0,0};
+  uint8_t n=parseList(args.text, v, 6);
+  if(n==0 || (n==1 && v[0]==0)){
+    sweep.stop();
+    Serial_print("Sweep stopped, steps per second: ");
+    Serial_println(sweep.stepsPerSecond());
+    return;
+  }
+  if(n<4 || v[0]<0 || v[1]<0 || v[2]<=0){
+    Serial_println("Sweep options: FS<start>,<stop>,<step>,<dwell us>[,<lock gate 0/1>[,<repeat 0/1>]]");
+    return;
+  }
+  hop.disarm();
+  modScheduler.flush();
+  linearRamp=0;
+  sineWave=0;
+  triangle=0;
+  randomMod=0;
+  customDepth=0;
+  modGraph.clear();
+  uint16_t count=sweep.build(v[0], v[1], v[2]);
+  if(count==0){
+    Serial_print("Sweep could not be solved, max steps: ");
+    Serial_println(REG_TABLE_SIZE);
+    return;
+  }
+  if(!sweep.start(v[3]<0 ? 0 : v[3], v[4]!=0, v[5]!=0)){
+    Serial_print("Sweep dwell out of range (us): ");
+    Serial_print(SWEEP_DWELL_MIN_US);
+    Serial_print("-");
+    Serial_println(SWEEP_DWELL_MAX_US);
+    return;
+  }
+  last_f=v[0];
+  setpoint_freq=last_f;
+  current_freq=last_f;
+  lock_enable=false;
+  sweep_port=serialTx.route;
+  Serial_print("Sweep started, steps: ");
+  Serial_println(count);
+}
+
+void hopStatus()
+{
+  Serial_print(hop.armed() ? "Hop armed, next: " : "Hop disarmed, next: ");
+  Serial_print(hop.next);
+  Serial_print("/");
+  Serial_print(hop.size());
+  Serial_print(", hops: ");
+  Serial_println(hop.hops);
+  //Trigger edge to R0 latch, by the number of registers each hop wrote
+  for (uint8_t regs=1; regs<=HOP_REGS_MAX; regs++) {
+    if(hop.latencyHops(regs)==0){
+      continue;
+    }
+    Serial_print("Hop latency ");
+    Serial_print(regs);
+    Serial_print(regs==1 ? " register" : " registers");
+    Serial_print(", hops/min/max (ns): ");
+    Serial_print(hop.latencyHops(regs));
+    Serial_print("/");
+    Serial_print(hop.latencyMin(regs));
+    Serial_print("/");
+    Serial_println(hop.latencyMax(regs));
+  }
+  Serial_print("Hop latency last (ns): ");
+  Serial_print(hop.latencyLast());
+  Serial_print(", registers: ");
+  Serial_println(hop.latencyLastRegs());
+}
+
+//N hop list commands: NC clear, NA<freq>[,<power 0-3>] add, NS share one MOD, NG[<index>] arm
+//the trigger, NT software trigger, NX disarm, N on its own shows the list state
+void hopCommand(const CmdArgs &args)
+{
+  if (args.startsWith("C")) {
+    hop.clear();
+    Serial_println("Hop list cleared");
+  } else if (args.startsWith("A")) {
+    int64_t v[2]={0, HOP_POWER_KEEP};
+    if(parseList(args.text+1, v, 2)==0 || v[0]<0 || !hop.add(v[0], v[1])){
+      Serial_print("Hop entry not added, max entries: ");
+      Serial_println(HOP_MAX_ENTRIES);
+      return;
+    }
+    Serial_print("Hop entries: ");
+    Serial_println(hop.size());
+  } else if (args.startsWith("S")) {
+    uint16_t mod=hop.share();
+    if(mod==0){
+      Serial_println("Hop list empty, reload with NA");
+      return;
+    }
+    Serial_print("Hop set MOD: ");
+    Serial_print(mod);
+    Serial_print(", shared: ");
+    Serial_print(hop.size()-hop.apartCount());
+    Serial_print(", apart: ");
+    Serial_println(hop.apartCount());
+    if(hop.apartCount()>0){
+      Serial_print("Apart entries:");
+      for (uint16_t i=0; i<hop.size(); i++) {
+        if(hop.apart(i)){
+          Serial_print(" ");
+          Serial_print(i);
+        }
+      }
+      Serial_println();
+    }
+  } else if (args.startsWith("G")) {
+    sweep.stop();
+    modScheduler.flush();
+    linearRamp=0;
+    sineWave=0;
+    triangle=0;
+    randomMod=0;
+    customDepth=0;
+    modGraph.clear();
+    if(!hop.arm(args.sub(1).toInt())){
+      Serial_println("Hop list empty, reload with NA");
+      return;
+    }
+    lock_enable=false;
+    Serial_println("Hop trigger armed");
+  } else if (args.startsWith("T")) {
+    if(hop.armed()){
+      hop.trigger();
+    }
+  } else if (args.startsWith("X")) {
+    hop.disarm();
+    Serial_println("Hop trigger disarmed");
+  } else {
+    hopStatus();
+  }
+}
+
+void lockReport(uint8_t result)
+{
+  if(result==LOCK_LOCKED){
+    Serial_print("Locked, lock time (us): ");
+    Serial_println(lockDetect.lastUs());
+  } else {
+    Serial_println("Lock timeout");
+  }
+}
+
+void lockStatus()
+{
+  lockDetect.lock();
+  Serial_print("Lock time min/avg/max (us): ");
+  Serial_print(lockDetect.minUs());
+  Serial_print("/");
+  Serial_print(lockDetect.avgUs());
+  Serial_print("/");
+  Serial_print(lockDetect.maxUs());
+  Serial_print(", locks: ");
+  Serial_print(lockDetect.locks);
+  Serial_print(", timeouts: ");
+  Serial_print(lockDetect.timeouts);
+  Serial_print(", superseded: ");
+  Serial_println(lockDetect.superseded);
+  lockDetect.unlock();
+}
+
+//QL lock time commands: QL statistics and histogram, QLR reset, QLW<us> wait for the
+//last retune to lock, QLA<us> report the lock later without holding up the port
+void lockCommand(const CmdArgs &args)
+{
+  if (args.startsWith("R")) {
+    lockDetect.lock();
+    lockDetect.resetStats();
+    lockDetect.unlock();
+    Serial_println("Lock statistics reset");
+  } else if (args.startsWith("W") || args.startsWith("A")) {
+    int32_t timeout=args.sub(1).number ? args.sub(1).toInt() : LOCK_WINDOW_US;
+    if(timeout<1 || timeout>LOCK_WAIT_MAX_US){
+      Serial_print("Lock wait out of range (us): 1-");
+      Serial_println(LOCK_WAIT_MAX_US);
+    } else if(args.startsWith("W")){
+      lockReport(lockDetect.wait(timeout));
+    } else {
+      lockDetect.waitStart(timeout);
+      lock_port=serialTx.route;
+    }
+  } else {
+    lockStatus();
+    Serial_println("Lock time histogram (us):");
+    for (uint8_t i=0; i<LOCK_HIST_BINS; i++) {
+      uint32_t n=lockDetect.hist[i];
+      if(n==0){
+        continue;
+      }
+      Serial_print(LockDetect::binUs(i));
+      if(i<LOCK_HIST_BINS-1){
+        Serial_print("-");
+        Serial_print(LockDetect::binUs(i+1)-1);
+      } else {
+        Serial_print("+");
+      }
+      Serial_print(": ");
+      Serial_println(n);
+    }
+  }
+}
+
+void glideReport()
+{
+  Serial_print("Glide done, requested/achieved (us): ");
+  Serial_print((uint32_t)glide.requestedUs());
+  Serial_print("/");
+  Serial_println((uint32_t)glide.achievedUs());
+}
+
+void glideStatus()
+{
+  Serial_print("G/J/K: Glide: ");
+  Serial_print(Glide::name(glide.mode()));
+  if(glide.mode()==GLIDE_SLEW){
+    Serial_print(", Hz/s: ");
+  } else {
+    Serial_print(", ms: ");
+  }
+  Serial_println(glide.value());
+  Serial_print("Last glide requested/achieved (us): ");
+  Serial_print((uint32_t)glide.requestedUs());
+  Serial_print("/");
+  Serial_println((uint32_t)glide.achievedUs());
+}
+
+//G linear and J exponential glide time in ms, K constant slew rate in Hz per second,
+//0 turns any of them off
+void glideCommand(uint8_t mode, int32_t value)
+{
+  if(mode==GLIDE_SLEW && value<0){
+    Serial_print("Glide rate out of range (Hz/s): 0-");
+    Serial_println(INT32_MAX);
+    return;
+  }
+  if(value<0 || !glide.set(mode, value)){
+    Serial_print("Glide time out of range (ms): 0-");
+    Serial_println(GLIDE_TIME_MAX_MS);
+    return;
+  }
+  if(!glide.active() && glide.running()){
+    //With glides off the modulation loop stops, so go to the setpoint now
+    uint64_t f=glide.stop();
+    vfo.optimise_f_only(f);
+    current_freq=f;
+    vfo.lock_freq();
+    lock_enable=true;
+  }
+  glide_report=false;
+  Serial_print("Glide set to: ");
+  Serial_print(Glide::name(glide.mode()));
+  Serial_print(" ");
+  Serial_println(glide.value());
+}
+
+void modGraphStatus()
+{
+  for (uint8_t i=0; i<MOD_SLOTS; i++) {
+    const ModSlot &s=modGraph.slot(i);
+    Serial_print("XM");
+    Serial_print(i+1);
+    if(s.depth==0){
+      Serial_println(": off");
+      continue;
+    }
+    Serial_print(": ");
+    Serial_print(ModGraph::letter(s.shape));
+    Serial_print(" ");
+    Serial_print(s.depth);
+    Serial_print(" Hz, ");
+    Serial_print(s.rate_mHz);
+    Serial_println(" mHz");
+  }
+}
+
+//XM modulation slots summed with the main LFO: XM lists them, XMC clears them and
+//XM<slot><shape><depth>[,<rate mHz>] sets one, e.g. XM1S100000,500 is a 100 kHz sine at
+//0.5 Hz. The shapes are L, S, O, C and Z as the commands, a depth of 0 turns the slot off
+void modGraphCommand(const CmdArgs &args)
+{
+  if (args.startsWith("C")) {
+    modGraph.clear();
+    Serial_println("Modulation slots cleared");
+    return;
+  }
+  if (!args.number) {
+    modGraphStatus();
+    return;
+  }
+  int64_t slot;
+  const char *end;
+  parseInt64(args.text, slot, &end);
+  uint8_t shape=ModGraph::shape(*end);
+  int64_t v[2]={0,0};
+  uint8_t n=shape==MOD_SHAPE_OFF ? 0 : parseList(end+1, v, 2);
+  if(n==0 || slot<1 || slot>MOD_SLOTS || v[0]<INT32_MIN || v[0]>INT32_MAX || v[1]<0 || v[1]>MOD_SLOT_RATE_MAX_MHZ){
+    Serial_println("Modulation slot options: XM<1-4><L/S/O/C/Z><depth Hz>[,<rate 0-10000000 mHz>], XMC=clear");
+    return;
+  }
+  if(shape==MOD_SHAPE_CUSTOM && customWaveSize==0 && v[0]!=0){
+    Serial_println("No custom waveform loaded");
+    return;
+  }
+  modGraph.set(slot-1, shape, v[0], v[1]);
+  glide_step_us=micros(); //Slot phases advance from now
+  modGraphStatus();
+}
+
+//QP retune pipeline profile: count and min/mean/max time of each stage, QPR resets it
+void profileCommand(const CmdArgs &args)
+{
+  if (args.startsWith("R")) {
+    profiler.reset();
+    Serial_println("Profile reset");
+    return;
+  }
+  Serial_println("Stage: count, min/mean/max (ns)");
+  for (uint8_t i=0; i<PROF_STAGES; i++) {
+    ProfStage s=profiler.get(i);
+    Serial_print(Profiler::name(i));
+    Serial_print(": ");
+    Serial_print(s.count);
+    Serial_print(", ");
+    Serial_print(Profiler::ns(s.min));
+    Serial_print("/");
+    Serial_print(s.count==0 ? 0 : Profiler::ns(s.sum/s.count));
+    Serial_print("/");
+    Serial_println(Profiler::ns(s.max));
+  }
+}
+
+//Runs one tokenized text command. Returns false for an unknown command letter
+bool runCommand(const CmdArgs &args)
+{
+  bool valid=true;
+  if(lfo_playing){
+    //Pick up the live modulation from the last table entry played
+    setpoint_freq=lfoSetpoint(lfo_phase);
+    current_freq=setpoint_freq;
+    lfo_playing=false;
+  }
+  modScheduler.lock();
+  sweep.lock();
+  hop.lock();
+  switch (args.letter)
+  {
+    case 'A':
+    {
+      uint16_t pwrlevel = args.toInt();
+      uint16_t pwrSet = vfo.setAmplitude(pwrlevel);
+      Serial_print("Amplitude set to: ");
+      Serial_println(pwrSet);
+      deltaAmplitude=-1;
+      break;
+    }
+    case 'B':
+    {
+      int32_t sleep_time = args.toInt();
+      if(sleep_time<0){
+        sleep_time=0;
+      } else if (sleep_time>120000){
+        sleep_time=120000;
+      }
+      Serial_print("Waiting for: ");
+      Serial_print(sleep_time);
+      Serial_println("ms");
+      delay(sleep_time);
+      Serial_println("Wait completed");
+      break;
+    }
+    case 'C':
+    {
+      if (args.startsWith("U")) {
+        if(!serialMute){
+          delay(20);
+          while(Serial_available()){
+            readSerialData(); //Drop the rest of the line ending before the binary block
+          }
+          Serial_println("Send waveform block");
+        }
+        int32_t samples = customWaveUpload(1000);
+        if(samples>0){
+          Serial_print("Custom waveform loaded: ");
+          Serial_print(samples);
+          Serial_println(" samples");
+        } else {
+          Serial_println("Custom waveform upload failed");
+        }
+        break;
+      }
+      customDepth = args.toInt();
+      if(customWaveSize==0 && customDepth!=0){
+        Serial_println("No custom waveform loaded");
+        customDepth=0;
+        break;
+      }
+      Serial_print("Custom waveform sweep set to: ");
+      Serial_println(customDepth);
+      linearRamp=0;
+      sineWave=0;
+      triangle=0;
+      randomMod=0;
+      break;
+    }
+    case 'D':
+    {
+      vfo.disable();
+      Serial_println("Disabled RF");
+      linearRamp=0;
+      sineWave=0;
+      triangle=0;
+      randomMod=0;
+      customDepth=0;
+      modGraph.clear();
+      randomDither=0;
+      deltaAmplitude=-1;
+      break;
+    }
+    case 'E':
+    {
+      vfo.enable();
+      Serial_println("Enabled RF");
+      break;
+    }
+    case 'F':
+    {
+      if (args.startsWith("S")) {
+        sweepCommand(args.sub(1));
+        break;
+      }
+      sweep.stop();
+      hop.disarm();
+      uint64_t f = args.value<0 ? 0 : args.value;
+      last_f=f;
+      setpoint_freq=f;
+      if(!glide.active()){
+        vfo.optimise_f_only(f, !serialMute, !serialMute);
+        current_freq=f;
+        vfo.lock_freq();
+        lock_enable=true;
+      } else {
+        Serial_print("Frequency setpoint set to: ");
+        Serial_println(f); 
+        glide.start(current_freq, f, micros());
+        glide_port=serialTx.route;
+        glide_report=true;
+      }
+      linearRamp=0;
+      sineWave=0;
+      triangle=0;
+      randomMod=0;
+      customDepth=0;
+      modGraph.clear();
+      break;
+    }
+    case 'G':
+    {
+      glideCommand(GLIDE_LINEAR, args.toInt());
+      break;
+    }
+    case 'H':
+    {
+      Serial_println("H: ADF4351 STM32F103CB Help->");
+      Serial_println("A: Set amplitude                     (0-4)");
+      Serial_println("B: Time delay in milliseconds        (0-120000)");
+      Serial_println("C: Set custom waveform modulation    (0=stop, -/+____ Hz, or U=upload)");
+      Serial_println("D: Disable RF");
+      Serial_println("E: Enable RF");
+      Serial_println("F: Set frequency                     (35000000 - 4400000000 Hz, or S=sweep)");
+      Serial_println("G: Linear Glide Time                 (0-600000 ms)");
+      Serial_println("I: Frequency information");
+      Serial_println("J: Exponential Glide Time            (0-600000 ms)");
+      Serial_println("K: Constant Glide Rate               (0=off, 1-2147483647 Hz/s)");
+      Serial_println("L: Set linear frequency ramp         (0=stop, or: -/+____ Hz)");
+      Serial_println("M: Morse Code                        (string)");
+      Serial_println("Morse: enter morse only mode         (ESC to exit)");
+      Serial_println("N: Frequency hop list                (C=clear, A<freq>[,<power>]=add, S=share MOD, G[<index>]=arm, T=trigger, X=disarm)");
+      Serial_println("O: Set triangle frequency modulation (0=stop, or: -/+____ Hz)");
+      Serial_println("P: Set phase angle                   (0.0-360.0 deg.)");
+      Serial_println("Q: Query                             (S=SPI benchmark, L=lock time, LW<us>/LA<us>=wait for lock, P=profile, LR/PR=reset, M=math benchmark)");
+      Serial_println("R: Register information");
+      Serial_println("S: Set sinewave frequency modulation (0=stop, or: -/+____ Hz)");
+      Serial_println("T: Terminal settings for this port   (E0/E1=echo off/on, B1200-2250000=UART baud)");
+      Serial_println("U: Modulation sample rate            (0=free running, or: 1-20000 Hz)");
+      Serial_println("V: Set random dither frequency width (0=stop, or: -/+____ Hz)");
+      Serial_println("W: Morse Code words per minute       (5-120 WPM)");
+      Serial_println("X: Modulation LFO Speed              (1-1024, R0-10000000 = rate in mHz, or M=slots)");
+      Serial_println("Y: Set sigma-delta amplitude         (-1=stop, or: 0-65535)");
+      Serial_println("Z: Set random frequency modulation   (0=stop, or: -/+____ Hz)");
+      Serial_println("0xA5 0x5A: Binary framed protocol    (see binary_protocol.h)");
+      break;
+    }
+    case 'I':
+    {
+      vfo.freqInfo();
+      Serial_println();
+      Serial_println("Mod options:");
+      Serial_print("C: Custom waveform: ");
+      Serial_print(customDepth);
+      Serial_print(" Hz, samples: ");
+      Serial_println(customWaveSize);
+      glideStatus();
+      Serial_print("L: Linear ramp: ");
+      Serial_println(linearRamp);
+      Serial_print("S: Sinewave: ");
+      Serial_println(sineWave);
+      Serial_print("T: Triangle: ");
+      Serial_println(triangle);
+      Serial_print("V: Random Dither:");
+      Serial_println(randomDither*2);
+      Serial_print("X: Modulation Speed: ");
+      Serial_println(mod_speed);
+      Serial_print("XR: Modulation rate (mHz): ");
+      Serial_println(lfo_rate_mHz);
+      modGraphStatus();
+      Serial_print("Y: Sigma delta Amplitude: ");
+      Serial_println(deltaAmplitude);
+      Serial_print("Z: Random Modulation: ");
+      Serial_println(randomMod);
+      Serial_print("Lock Enable: ");
+      Serial_println(lock_enable);
+      Serial_print("U: Modulation rate (Hz): ");
+      Serial_println(modScheduler.rate());
+      Serial_print("Modulation frames: ");
+      Serial_println(modScheduler.frames);
+      Serial_print("Modulation overruns: ");
+      Serial_println(modScheduler.overruns);
+      Serial_print("LFO table entries: ");
+      Serial_println(lfo_table_valid && lfoTable.user==REG_TABLE_LFO ? lfoTable.size() : 0);
+      hopStatus();
+      lockStatus();
+      Serial_print("Sweep: ");
+      Serial_print(sweep.running() ? "running, step " : "stopped, step ");
+      Serial_print(sweep.index+1);
+      Serial_print("/");
+      Serial_print(sweep.size());
+      Serial_print(", steps per second: ");
+      Serial_print(sweep.stepsPerSecond());
+      Serial_print(", lock timeouts: ");
+      Serial_println(sweep.lockTimeouts);
+      Serial_print("Serial TX dropped bytes (USB/UART): ");
+      Serial_print(serialTx.usb.dropped);
+      Serial_print("/");
+      Serial_println(serialTx.uart.dropped);
+      Serial_print("Parse cycles: ");
+      Serial_println(parse_cycles);
+      break;
+    }
+    case 'J':
+    {
+      glideCommand(GLIDE_EXP, args.toInt());
+      break;
+    }
+    case 'K':
+    {
+      glideCommand(GLIDE_SLEW, args.toInt());
+      break;
+    }
+    case 'L':
+    {
+      linearRamp = args.toInt();
+      Serial_print("Linear ramp sweep set to: ");
+      Serial_println(linearRamp);
+      sineWave=0;
+      triangle=0;
+      randomMod=0;
+      customDepth=0;
+      break;
+    }
+    case'M':
+    {
+      if (args.startsWith("ORSE")) {
+        //Interactive Morse Code mode
+        interactiveMorseCode(enableRF,disableRF, wpm);
+      } else {
+        String morseString = writeMorseString(args.text);
+        //Send only current string as Morse Code
+        processMorseString(morseString,enableRF,disableRF,wpm);
+      }
+      break;
+    }
+    case 'N':
+    {
+      hopCommand(args);
+      break;
+    }
+    case 'O':
+    {
+      triangle = args.toInt();
+      Serial_print("Triangle sweep set to: ");
+      Serial_println(triangle);
+      sineWave=0;
+      linearRamp=0;
+      randomMod=0;
+      customDepth=0;
+      break;
+    }
+    case 'P':
+    {
+      double phaseAngle = args.milli/1000.0;
+      double phaseSet=vfo.setPhaseAngle(phaseAngle);
+      Serial_print("Phase angle set to: ");
+      Serial_println(phaseSet);
+      break;
+    }
+    case 'Q':
+    {
+      if (args.startsWith("S")) {
+        uint32_t ns = vfo.benchmarkSPI(1000);
+#ifdef USE_FAST_SPI
+        Serial_print("SPI (BSRR) ns per register word: ");
+#else
+        Serial_print("SPI (BitBangedSPI) ns per register word: ");
+#endif
+        Serial_println(ns);
+      } else if (args.startsWith("L")) {
+        lockCommand(args.sub(1));
+      } else if (args.startsWith("P")) {
+        profileCommand(args.sub(1));
+      } else if (args.startsWith("M")) {
+        uint32_t fixed_cycles, double_cycles;
+        uint32_t differ=modMathBenchmark(1000, fixed_cycles, double_cycles);
+        Serial_print("LFO cycles per step, fixed point/double: ");
+        Serial_print(fixed_cycles);
+        Serial_print("/");
+        Serial_print(double_cycles);
+        Serial_print(", results that differ: ");
+        Serial_println(differ);
+      } else {
+        Serial_println("Query options: QS=SPI benchmark, QL=lock time (R=reset, W<us>=wait, A<us>=wait in background), QP=retune profile (R=reset), QM=modulation math benchmark");
+      }
+      break;
+    }
+    case 'R':
+    {
+      vfo.regInfo();
+      break;
+    }
+    case 'S':
+    {
+      sineWave = args.toInt();
+      Serial_print("Sinewave sweep set to: ");
+      Serial_println(sineWave);
+      linearRamp=0;
+      triangle=0;
+      randomMod=0;
+      customDepth=0;
+      break;
+    }
+    case 'T':
+    {
+      if (args.startsWith("E")) {
+        session->echo = args.sub(1).toInt()!=0;
+        Serial_print("Echo set to: ");
+        Serial_println(session->echo);
+      } else if (args.startsWith("B")) {
+        int32_t baud = args.sub(1).toInt();
+        if(!uartDmaBaudValid(baud)){
+          Serial_print("UART baud rate not possible, current: ");
+          Serial_println(uartDmaBaud());
+          break;
+        }
+        Serial_print("UART baud rate set to: ");
+        Serial_println(baud);
+        //Over the UART itself the host has to answer at the new rate or it reverts
+        uartDmaSetBaud(baud, session->port==SERIAL_PORT_UART);
+      } else {
+        Serial_println("Terminal options: E0/E1=echo off/on, B=UART baud rate");
+      }
+      break;
+    }
+    case 'U':
+    {
+      int32_t rate = args.toInt();
+      if(rate<=0){
+        modScheduler.stop();
+        Serial_println("Modulation rate: free running");
+      } else if(modScheduler.start(rate)){
+        Serial_print("Modulation rate set to: ");
+        Serial_print(rate);
+        Serial_println("Hz");
+      } else {
+        Serial_print("Modulation rate out of range, max ");
+        Serial_println(MOD_RATE_MAX_HZ);
+      }
+      break;
+    }
+    case 'V':
+    {
+      randomDither = args.toInt();
+      Serial_print("Random diter frequency width set to: ");
+      Serial_println(randomDither);
+      randomDither/=2; //Divide by two as amplitude spread equally either side of carrier
+      break;
+    }
+    case 'W':
+    {
+      wpm = args.toInt();
+      if(wpm<5){
+        wpm=5;
+      } else if (wpm>120){
+        wpm=120;
+      }
+      Serial_print("Morse Code speed set to: ");
+      Serial_print(wpm);
+      Serial_println(" words per minute");
+      break;
+    }
+    case 'X':
+    {
+      if (args.startsWith("M")) {
+        modGraphCommand(args.sub(1));
+        break;
+      }
+      if (args.startsWith("R")) {
+        int32_t rate = args.sub(1).toInt();
+        if(rate<0){
+          rate=0;
+        } else if(rate>LFO_RATE_MAX_MHZ){
+          rate=LFO_RATE_MAX_MHZ;
+        }
+        lfo_rate_mHz=rate;
+        lfo_last_us=micros();
+        Serial_print("Modulation rate set to (mHz): ");
+        Serial_println(lfo_rate_mHz);
+        break;
+      }
+      lfo_rate_mHz=0;
+      mod_speed = args.toInt();
+      if(mod_speed<1){
+        mod_speed=1;
+      } else if (mod_speed>1024){
+        mod_speed=1024;
+      }
+      Serial_print("Modulation speed set to: ");
+      Serial_println(mod_speed);
+      break;
+    }
+    case 'Y':
+    {
+      int32_t pwrlevel = args.toInt();
+      if(pwrlevel!=-1){
+        vfo.setSigmaDeltaAmplitude(pwrlevel);
+        Serial_print("Sigma-delta amplitude set to: ");
+        Serial_println(pwrlevel);
+      } else {
+        vfo.setAmplitude(0);
+        Serial_print("Sigma-delta amplitude: disabled ");
+      }
+      deltaAmplitude=pwrlevel;
+      break;
+    }
+    case 'Z':
+    {
+      randomMod = args.toInt();
+      Serial_print("Random modulation set to: ");
+      Serial_println(randomMod);
+      linearRamp=0;
+      sineWave=0;
+      triangle=0;
+      customDepth=0;
+      break;
+    }
+    default:
+      // Invalid command
+      Serial_println("Invalid command");
+      valid=false;
+      break;
+  }
+  modulation_enable=(linearRamp!=0 | sineWave!=0 | triangle!=0 | customDepth!=0 | randomMod!=0 | modGraph.active() | glide.active() | randomDither>0);
+  hop.unlock();
+  sweep.unlock();
+  modScheduler.unlock();
+  if(modulation_enable==false){
+    modScheduler.flush();
+  }
+  return valid;
+}
+
+//Runs a binary protocol frame through the text command handlers with the text replies muted
+uint8_t binaryCommand(const char *line, uint64_t &value)
+{
+  CmdArgs args;
+  uint32_t start = Profiler::start();
+  cmdParse(line, args);
+  profiler.end(PROF_PARSE, start);
+  char letter=args.letter;
+  if(letter=='H' || letter=='I' || letter=='Q' || letter=='R' || (letter=='M' && args.startsWith("ORSE"))){
+    return BIN_STATUS_UNSUPPORTED; //Text reports and interactive modes
+  }
+  uint8_t status=BIN_STATUS_OK;
+  if(letter!=0){
+    serialMute=true;
+    if(!runCommand(args)){
+      status=BIN_STATUS_UNSUPPORTED;
+    }
+    serialMute=false;
+  }
+  vfo.syncFromRegisters();
+  value=vfo.cfreq;
+  return status;
+}
+
+//Handles the received characters of one port, replies go back to the same port
+void sessionInput(CommandSession &s)
 {
-  static String command = "";
+  CommandLine &command = s.line;
+  session = &s;
+  serialTx.route = s.port;
   while (Serial_available())
   {
     char c = readSerialData();
+    uint32_t lost = s.port==SERIAL_PORT_UART ? uartDmaLost() : 0;
+    if(lost>0){
+      //The line or frame in progress has a hole in it
+      command.lose();
+      s.binary.resync();
+      if(!s.binary.active()){
+        Serial_print("\r\nUART input overrun, bytes lost: ");
+        Serial_println(lost);
+      }
+    }
+    if (s.binary.active()) {
+      s.binary.byte(c, binaryCommand);
+      continue;
+    }
+    if (s.binary.magic(c)) {
+      continue; //Binary mode entry sequence, not echoed
+    }
     // Echo back the received character
-    Serial_print(c);
+    if (s.echo) {
+      Serial_print(c);
+    }
     // Convert the received character to uppercase
     c = toupper(c);
 
     // Check if the received character is a newline or carriage return
     if (c == '\n' || c == '\r')
     {
-      Serial_println();
+      if (s.echo) {
+        Serial_println();
+      }
       // Process the command if it's not empty
-      if (command.length() > 0)
+      if (command.overflow())
       {
-        char firstChar = command[0];
-        command.remove(0, 1);  // Remove the first character
-        switch (firstChar)
-        {
-          case 'A':
-          {
-            uint16_t pwrlevel = command.toInt();
-            uint16_t pwrSet = vfo.setAmplitude(pwrlevel);
-            Serial_print("Amplitude set to: ");
-            Serial_println(pwrSet);
-            deltaAmplitude=-1;
-            break;
-          }
-          case 'B':
-          {
-            int32_t sleep_time = command.toInt();
-            if(sleep_time<0){
-              sleep_time=0;
-            } else if (sleep_time>120000){
-              sleep_time=120000;
-            }
-            Serial_print("Waiting for: ");
-            Serial_print(sleep_time);
-            Serial_println("ms");
-            delay(sleep_time);
-            Serial_println("Wait completed");
-            break;
-          }
-          case 'D':
-          {
-            vfo.disable();
-            Serial_println("Disabled RF");
-            linearRamp=0;
-            sineWave=0;
-            triangle=0;
-            randomMod=0;
-            randomDither=0;
-            deltaAmplitude=-1;
-            break;
-          }
-          case 'E':
-          {
-            vfo.enable();
-            Serial_println("Enabled RF");
-            break;
-          }
-          case 'F':
-          {
-            uint32_t f = command.toInt();
-            last_f=f;
-            setpoint_freq=f;
-            if(glide==0 && exp_glide==0 && constant_glide==0){
-              vfo.optimise_f_only(f, true, true);
-              current_freq=f;
-              vfo.lock_freq();
-              lock_enable=true;
-            } else {
-              Serial_print("Frequency setpoint set to: ");
-              Serial_println(f); 
-              startpoint_freq=current_freq;
-              calc_freq_step=true;
-            }
-            linearRamp=0;
-            sineWave=0;
-            triangle=0;
-            randomMod=0;
-            break;
-          }
-          case 'G':
-          {
-            glide = command.toInt();
-            if(glide<0){
-              glide=0;
-            }
-            Serial_print("Glide set to: ");
-            Serial_println(glide);
-            exp_glide=0;
-            constant_glide=0;
-            break;
-          }
-          case 'H':
-          {
-            Serial_println("H: ADF4351 STM32F103CB Help->");
-            Serial_println("A: Set amplitude                     (0-4)");
-            Serial_println("B: Time delay in milliseconds        (0-120000)");
-            Serial_println("D: Disable RF");
-            Serial_println("E: Enable RF");
-            Serial_println("F: Set frequency                     (35000000 - 4400000000 Hz)");
-            Serial_println("G: Glide Time                        (0-2000 ms)");
-            Serial_println("I: Frequency information");
-            Serial_println("J: Exponential Glide Time            (0-2000 ms)");
-            Serial_println("K: Constant Glide Time               (0-2000 ms)");
-            Serial_println("L: Set linear frequency ramp         (0=stop, or: -/+____ Hz)");
-            Serial_println("M: Morse Code                        (string)");
-            Serial_println("Morse: enter morse only mode         (ESC to exit)");
-            Serial_println("O: Set triangle frequency modulation (0=stop, or: -/+____ Hz)");
-            Serial_println("P: Set phase angle                   (0.0-360.0 deg.)");
-            Serial_println("R: Register information");
-            Serial_println("S: Set sinewave frequency modulation (0=stop, or: -/+____ Hz)");
-            Serial_println("V: Set random dither frequency width (0=stop, or: -/+____ Hz)");
-            Serial_println("W: Morse Code words per minute       (5-120 WPM)");
-            Serial_println("X: Modulation LFO Speed              (1-1024)");
-            Serial_println("Y: Set sigma-delta amplitude         (-1=stop, or: 0-65535)");
-            Serial_println("Z: Set random frequency modulation   (0=stop, or: -/+____ Hz)");
-            break;
-          }
-          case 'I':
-          {
-            vfo.freqInfo();
-            Serial_println();
-            Serial_println("Mod options:");
-            Serial_print("G: Linear glide: ");
-            Serial_println(glide);
-            Serial_print("J: Expontential glide: ");
-            Serial_println(exp_glide);
-            Serial_print("K: Constant glide: ");
-            Serial_println(constant_glide);
-            Serial_print("L: Linear ramp: ");
-            Serial_println(linearRamp);
-            Serial_print("S: Sinewave: ");
-            Serial_println(sineWave);
-            Serial_print("T: Triangle: ");
-            Serial_println(triangle);
-            Serial_print("V: Random Dither:");
-            Serial_println(randomDither*2);
-            Serial_print("X: Modulation Speed: ");
-            Serial_println(mod_speed);
-            Serial_print("Y: Sigma delta Amplitude: ");
-            Serial_println(deltaAmplitude);
-            Serial_print("Z: Random Modulation: ");
-            Serial_println(randomMod);
-            Serial_print("Lock Enable: ");
-            Serial_println(lock_enable);
-            Serial_print("Freq step: ");
-            Serial_println(freq_step);
-            break;
-          }
-          case 'J':
-          {
-            exp_glide = command.toInt();
-            if(exp_glide<0){
-              exp_glide=0;
-            }
-            Serial_print("Exponential Glide set to: ");
-            Serial_println(exp_glide);
-            glide=0;
-            constant_glide=0;
-            break;
-          }
-          case 'K':
-          {
-            constant_glide = command.toInt();
-            if(constant_glide<0){
-              constant_glide=0;
-            }
-            Serial_print("Constant Glide set to: ");
-            Serial_println(constant_glide);
-            calc_freq_step=true;
-            glide=0;
-            exp_glide=0;
-            break;
-          }
-          case 'L':
-          {
-            linearRamp = command.toInt();
-            Serial_print("Linear ramp sweep set to: ");
-            Serial_println(linearRamp);
-            sineWave=0;
-            triangle=0;
-            randomMod=0;
-            break;
-          }
-          case'M':
-          {
-            if (command.startsWith("ORSE")) {
-              //Interactive Morse Code mode
-              interactiveMorseCode(enableRF,disableRF, wpm);
-            } else {
-              String morseString = writeMorseString(command);
-              //Send only current string as Morse Code
-              processMorseString(morseString,enableRF,disableRF,wpm);
-            }
-            break;
-          }
-          case 'O':
-          {
-            triangle = command.toInt();
-            Serial_print("Triangle sweep set to: ");
-            Serial_println(triangle);
-            sineWave=0;
-            linearRamp=0;
-            randomMod=0;
-            break;
-          }
-          case 'P':
-          {
-            double phaseAngle = command.toFloat();
-            double phaseSet=vfo.setPhaseAngle(phaseAngle);
-            Serial_print("Phase angle set to: ");
-            Serial_println(phaseSet);
-            break;
-          }
-          case 'R':
-          {
-            vfo.regInfo();
-            break;
-          }
-          case 'S':
-          {
-            sineWave = command.toInt();
-            Serial_print("Sinewave sweep set to: ");
-            Serial_println(sineWave);
-            linearRamp=0;
-            triangle=0;
-            randomMod=0;
-            break;
-          }
-          case 'V':
-          {
-            randomDither = command.toInt();
-            Serial_print("Random diter frequency width set to: ");
-            Serial_println(randomDither);
-            randomDither/=2; //Divide by two as amplitude spread equally either side of carrier
-            break;
-          }
-          case 'W':
-          {
-            wpm = command.toInt();
-            if(wpm<5){
-              wpm=5;
-            } else if (wpm>120){
-              wpm=120;
-            }
-            Serial_print("Morse Code speed set to: ");
-            Serial_print(wpm);
-            Serial_println(" words per minute");
-            break;
-          }
-          case 'X':
-          {
-            mod_speed = command.toInt();
-            if(mod_speed<1){
-              mod_speed=1;
-            } else if (mod_speed>1024){
-              mod_speed=1024;
-            }
-            Serial_print("Modulation speed set to: ");
-            Serial_println(mod_speed);
-            break;
-          }
-          case 'Y':
-          {
-            int32_t pwrlevel = command.toInt();
-            if(pwrlevel!=-1){
-              vfo.setSigmaDeltaAmplitude(pwrlevel);
-              Serial_print("Sigma-delta amplitude set to: ");
-              Serial_println(pwrlevel);
-            } else {
-              vfo.setAmplitude(0);
-              Serial_print("Sigma-delta amplitude: disabled ");
-            }
-            deltaAmplitude=pwrlevel;
-            break;
-          }
-          case 'Z':
-          {
-            randomMod = command.toInt();
-            Serial_print("Random modulation set to: ");
-            Serial_println(randomMod);
-            linearRamp=0;
-            sineWave=0;
-            triangle=0;
-            break;
-          }
-          default:
-            // Invalid command
-            Serial_println("Invalid command");
-            break;
-        }
-        modulation_enable=(linearRamp!=0 | sineWave!=0 | triangle!=0 | randomMod!=0 | glide>0 | exp_glide>0 | constant_glide>0 | randomDither>0);
+        Serial_print("Command too long, max ");
+        Serial_println(CMD_LINE_MAX);
+      }
+      else if (command.lost())
+      {
+        Serial_println("Command dropped after input overrun");
+      }
+      else if (command.length() > 0)
+      {
+        CmdArgs args;
+        uint32_t start = Profiler::start();
+        cmdParse(command.text(), args);
+        parse_cycles = DWT->CYCCNT - start;
+        profiler.record(PROF_PARSE, parse_cycles);
+        runCommand(args);
       }
 
-      // Clear the command string for the next command
-      command = "";
+      // Clear the command line for the next command
+      command.clear();
     }
     else
     {
-      // Add the received character to the command string
-      command += c;
+      // Add the received character to the command line
+      command.add(c);
     }
   }
+}
+
+void processSerialInput()
+{
+  for (CommandSession &s : sessions) {
+    sessionInput(s);
+  }
+  if (sweep.finished()) {
+    serialTx.route = sweep_port;
+    Serial_print("Sweep done, steps per second: ");
+    Serial_println(sweep.stepsPerSecond());
+  }
+  uint8_t lock_result;
+  if (lockDetect.waitDone(lock_result)) {
+    serialTx.route = lock_port;
+    lockReport(lock_result);
+  }
+  if (glide.finished() && glide_report) {
+    serialTx.route = glide_port;
+    glideReport();
+  }
+  lockDetect.service();
   // Check if no data is available
-  if (Serial_available() == 0)
+  // With a fixed modulation rate, keep the next frame ready while characters arrive
+  if (Serial_available(SERIAL_PORT_ALL) == 0 || modScheduler.running())
   {
     if(deltaAmplitude>=0){
+      modScheduler.lock();
+      sweep.lock();
+      hop.lock();
       vfo.setSigmaDeltaAmplitude(deltaAmplitude);
+      hop.unlock();
+      sweep.unlock();
+      modScheduler.unlock();
     }
-    currentTime = micros(); // Get the end time
-    unsigned long elapsedTime = currentTime - startTime; // Calculate the elapsed time
       
-    if(modulation_enable==true){
-      freq_loop+=mod_speed;
-      if(freq_loop>=sin2048Size){
-        freq_loop=0;
+    if(modulation_enable==true && !sweep.running() && !hop.armed() && modScheduler.wantsFrame()){
+      uint32_t lfo_step;
+      if(lfo_rate_mHz==0){
+        lfo_step=(uint32_t)mod_speed<<LFO_INDEX_SHIFT;
+      } else {
+        //Phase step = rate * step time as a fraction of 2^32, whole cycles drop out
+        unsigned long now=micros();
+        uint32_t step_us=modScheduler.running() ? 1000000UL/modScheduler.rate() : now-lfo_last_us;
+        lfo_last_us=now;
+        uint64_t cycles_e9=((uint64_t)lfo_rate_mHz*step_us)%1000000000ULL;
+        lfo_step=(uint32_t)((cycles_e9<<32)/1000000000ULL);
       }
-      uint32_t freq=0;
-      if(linearRamp!=0){
-        setpoint_freq=last_f+(double)freq_loop/(double)sin2048Size*(double)linearRamp;
-        calc_freq_step=true;
-        startpoint_freq=current_freq;
-      } else if(sineWave!=0){
-        setpoint_freq=last_f+(double)sin2048[freq_loop]/65536.0f*(double)sineWave;
-        calc_freq_step=true;
-        startpoint_freq=current_freq;
-      } else if(triangle!=0){
-        double time_period = (double)triangle;
-        //double freq_range = (double)sin1024Size / time_period;
-        double time_offset = ((double)freq_loop / (double)sin2048Size) * triangle;
-        if (time_offset <= time_period / 2.0)
-        {
-          setpoint_freq = last_f + time_offset * 2;
-        }
-        else
-        {
-          setpoint_freq = last_f + (time_period - time_offset) * 2;
+      lfo_phase+=lfo_step; //Wraps at the end of each cycle
+      if(lfoTableReady(lfo_step)){
+        //Whole cycle already solved, just write the registers for this step
+        if(modScheduler.running()){
+          modScheduler.queueTable(lfo_phase>>LFO_TABLE_SHIFT);
+        } else {
+          lfoTable.play(vfo, lfo_phase>>LFO_TABLE_SHIFT);
         }
-        calc_freq_step=true;
-        startpoint_freq = current_freq;
-      } else if(randomMod!=0)
-      {
-        setpoint_freq=last_f+random(0, randomMod);
-        calc_freq_step=true;
-        startpoint_freq=current_freq;
-      }
-
-      if( calc_freq_step==true){
-        freq_step = int32_t(fabs((double)setpoint_freq - (double)(current_freq)) / (double)constant_glide);
-        calc_freq_step=false;
+        lfo_playing=true;
+        lock_enable=false;
+        return;
       }
-
-      if(exp_glide>0){
-        double freq_diff=(double)setpoint_freq-(double)current_freq;
-        freq=current_freq+(int32_t)(freq_diff/(double)exp_glide);
-      } else if(glide>0){
-        double freq_step=((double)setpoint_freq-(double)startpoint_freq)/(double)glide;
-        double freq_diff=(double)setpoint_freq-(double)current_freq;
-        if(fabsf(freq_diff)>fabsf(freq_step)){
-          freq=(int32_t)((double)current_freq + freq_step);
+      uint64_t freq=0;
+      unsigned long glide_now=micros();
+      bool lfo=linearRamp!=0 || sineWave!=0 || triangle!=0 || customDepth!=0;
+      if(lfo || randomMod!=0 || modGraph.active()){
+        //The main LFO or Z plus every XM slot make one setpoint, which is solved once below
+        if(lfo){
+          setpoint_freq=lfoSetpoint(lfo_phase);
+        } else if(randomMod!=0){
+          setpoint_freq=last_f+random(0, randomMod);
         } else {
-          freq=setpoint_freq; //When the setpoint is reached
-        }
-      } else if(constant_glide>0){
-        freq=current_freq;
-        if(freq != setpoint_freq){
-          int32_t adjusted_freq_step = freq_step * (double)elapsedTime / 1000000.0; // Adjust for iteration time in secs
-          if(adjusted_freq_step<1){
-            adjusted_freq_step=1;
-          }
-          if (freq < setpoint_freq) {
-            freq += adjusted_freq_step;
-            if (freq > setpoint_freq) {
-                freq = setpoint_freq;
-            }
-          } else {
-            freq -= adjusted_freq_step;
-            if (freq < setpoint_freq) {
-                freq = setpoint_freq;
-            }
-          }
+          setpoint_freq=last_f;
         }
+        uint32_t step_us=modScheduler.running() ? 1000000UL/modScheduler.rate() : glide_now-glide_step_us;
+        setpoint_freq+=modGraph.step(step_us);
+        //A moving setpoint restarts the glide each step, so the step covers the time since the last one
+        glide.start(current_freq, setpoint_freq, glide_step_us);
+        glide_report=false;
+      }
+      glide_step_us=glide_now;
+
+      if(glide.running()){
+        freq=glide.at(glide_now); //Position from the time since the glide started, not the step count
       } else {
-        freq=setpoint_freq; //Default with no glide
+        freq=setpoint_freq; //Default with no glide or once it has ended
       }
       if(randomDither!=0){
         freq+=random(-randomDither, +randomDither);
       }
       if(current_freq!=freq){
-        vfo.optimise_f_only(freq);
+        if(modScheduler.running()){
+          PLLPlan p;
+          if(vfo.planCached(freq, p)==0){
+            modScheduler.queuePlan(p);
+          } else {
+            modScheduler.queueHold();
+          }
+        } else {
+          vfo.optimise_f_only(freq);
+        }
         current_freq=freq;
         lock_enable=false;
-      } else {
-        if(lock_enable==false){
+      } else if(lock_enable==false){
+        if(modScheduler.running()){
+          modScheduler.queueLock();
+        } else {
           vfo.lock_freq();
-          lock_enable=true;
         }
+        lock_enable=true;
+      } else if(modScheduler.running()){
+        modScheduler.queueHold(); //Nothing to change this sample
       }
     }
   }
@@ -550,6 +1272,7 @@ void loop()
 
   //initialize the chip
   vfo.init() ;
+  lockDetect.begin();
   //enable frequency output
   vfo.enable() ;
 
@@ -0,0 +1,71 @@
+//
+//  mod_graph.h
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Modulation graph of MOD_SLOTS LFO slots (XM command). Each slot has its
+// own shape, depth and rate, and step() sums every slot into one frequency offset. The
+// main LFO, glide and dither are added around it in processSerialInput(), so however
+// many slots are in use each output sample is still solved once.
+//
+
+#ifndef MOD_GRAPH_H
+#define MOD_GRAPH_H
+
+#include <Arduino.h>
+
+#define MOD_SLOTS 4
+#define MOD_SLOT_RATE_MAX_MHZ 10000000 ///< 10 kHz, as XR
+
+#define MOD_SHAPE_OFF      0
+#define MOD_SHAPE_RAMP     1 ///< L
+#define MOD_SHAPE_SINE     2 ///< S
+#define MOD_SHAPE_TRIANGLE 3 ///< O
+#define MOD_SHAPE_CUSTOM   4 ///< C, the uploaded waveform
+#define MOD_SHAPE_RANDOM   5 ///< Z, a new random offset each cycle, or each sample at rate 0
+
+//Offset in Hz of a ramp, sine, triangle or custom shape at an LFO phase (one cycle is 2^32)
+typedef int64_t (*ModShapeFn)(uint8_t shape, uint32_t phase, int32_t depth);
+
+struct ModSlot
+{
+  uint8_t shape ;
+  int32_t depth ;     ///< Hz, 0 when the slot is off
+  uint32_t rate_mHz ;
+  uint64_t phase ;    ///< cycle fraction in 2^-48 units, bits 16-47 are the 32 bit LFO phase
+  uint64_t inc ;      ///< phase increment per us in the same units
+  int64_t hold ;      ///< random offset held until the next cycle
+};
+
+class ModGraph
+{
+  public:
+    ModGraph(ModShapeFn shapeOffset) : shapeOffset_(shapeOffset), active_(0) { clear(); }
+
+    //Set a slot (0 to MOD_SLOTS-1), a depth of 0 turns it off. Returns false if out of range
+    bool set(uint8_t slot, uint8_t shape, int32_t depth, uint32_t rate_mHz);
+    void clear();
+    bool active() const { return active_ != 0; }
+    const ModSlot &slot(uint8_t n) const { return slots_[n]; }
+
+    //MOD_SHAPE_ for a command letter (L, S, O, C or Z), MOD_SHAPE_OFF if none
+    static uint8_t shape(char letter);
+    static char letter(uint8_t shape);
+
+    //Advance every slot by step_us and return the sum of their offsets in Hz
+    int64_t step(uint32_t step_us);
+
+  private:
+    ModSlot slots_[MOD_SLOTS];
+    ModShapeFn shapeOffset_;
+    uint8_t active_; ///< bit per slot in use
+};
+
+#endif
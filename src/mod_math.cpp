@@ -0,0 +1,121 @@
+//
+//  mod_math.cpp
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Fixed point LFO arithmetic. Products of a 32 bit fraction and a 32 bit
+// depth fit in 64 bits, and the signed right shifts floor the Q32.32 result.
+//
+
+#include <Arduino.h>
+#include "mod_math.h"
+
+int64_t q32Scale(uint32_t fraction, int32_t depth)
+{
+  return ((int64_t)fraction * depth) >> 32;
+}
+
+int64_t q31Scale(int32_t sample, int32_t depth)
+{
+  return ((int64_t)sample * depth) >> 31;
+}
+
+int64_t triangleOffset(uint32_t phase, int32_t depth)
+{
+  //offset = phase * depth in Q32.32, compared with depth / 2 and doubled by the >> 31
+  int64_t offset = (int64_t)phase * depth;
+  if (offset <= ((int64_t)depth << 31)) {
+    return offset >> 31;
+  }
+  return (((int64_t)depth << 32) - offset) >> 31;
+}
+
+int64_t q32Mul(int64_t value, uint32_t fraction)
+{
+  //value = high * 2^32 + low, with only the low half needing a 64 bit product
+  int64_t high = value >> 32;
+  uint32_t low = (uint32_t)value;
+  return high * fraction + (int64_t)(((uint64_t)low * fraction) >> 32);
+}
+
+//The double arithmetic used before, kept for modMathBenchmark() only
+static uint64_t refScale(uint64_t base, uint32_t fraction, int32_t depth)
+{
+  return base + (double)fraction / 4294967296.0 * (double)depth;
+}
+
+static uint64_t refCustom(uint64_t base, int32_t sample, int32_t depth)
+{
+  return base + (double)sample / 2147483648.0 * (double)depth;
+}
+
+static uint64_t refTriangle(uint64_t base, uint32_t phase, int32_t depth)
+{
+  double time_period = (double)depth;
+  double time_offset = ((double)phase / 4294967296.0) * depth;
+  if (time_offset <= time_period / 2.0) {
+    return base + time_offset * 2;
+  }
+  return base + (time_period - time_offset) * 2;
+}
+
+#define BENCH_BASE  435000000ULL
+#define BENCH_EVALS 3 ///< evaluations per benchmark iteration
+
+static void benchFixed(uint32_t i, uint64_t *out)
+{
+  uint32_t phase = i * 0x9E3779B9UL;
+  out[0] = BENCH_BASE + q32Scale(phase, 100000 + (int32_t)(i & 0xFFFF));
+  out[1] = BENCH_BASE + q31Scale((int32_t)phase, -2500000);
+  out[2] = BENCH_BASE + triangleOffset(phase, 1234567);
+}
+
+static void benchDouble(uint32_t i, uint64_t *out)
+{
+  uint32_t phase = i * 0x9E3779B9UL;
+  out[0] = refScale(BENCH_BASE, phase, 100000 + (int32_t)(i & 0xFFFF));
+  out[1] = refCustom(BENCH_BASE, (int32_t)phase, -2500000);
+  out[2] = refTriangle(BENCH_BASE, phase, 1234567);
+}
+
+uint32_t modMathBenchmark(uint16_t count, uint32_t &fixed_cycles, uint32_t &double_cycles)
+{
+  uint64_t a[BENCH_EVALS], b[BENCH_EVALS];
+  volatile uint64_t sink = 0;
+  if (count == 0) {
+    count = 1;
+  }
+
+  uint32_t start = DWT->CYCCNT;
+  for (uint16_t i = 0; i < count; i++) {
+    benchFixed(i, a);
+    sink = sink + a[0] + a[1] + a[2];
+  }
+  fixed_cycles = (DWT->CYCCNT - start) / ((uint32_t)count * BENCH_EVALS);
+
+  start = DWT->CYCCNT;
+  for (uint16_t i = 0; i < count; i++) {
+    benchDouble(i, b);
+    sink = sink + b[0] + b[1] + b[2];
+  }
+  double_cycles = (DWT->CYCCNT - start) / ((uint32_t)count * BENCH_EVALS);
+
+  uint32_t differ = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    benchFixed(i, a);
+    benchDouble(i, b);
+    for (uint8_t k = 0; k < BENCH_EVALS; k++) {
+      if (a[k] != b[k]) {
+        differ++;
+      }
+    }
+  }
+  return differ;
+}
@@ -0,0 +1,41 @@
+//
+//  mod_math.h
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Fixed point LFO arithmetic. The STM32F103 has no FPU, so the modulation
+// loop works on integers only: LFO phases and samples are fractions of 2^32 (Q0.32) or
+// 2^31, and multiplying one by a depth in Hz gives a Q32.32 offset that is floored to
+// whole Hz. The results match the previous double arithmetic, which truncated
+// the (always positive) frequency, except where its rounding landed on a whole Hz the
+// exact value falls just short of and it read 1 Hz high (test/test_mod_math).
+// modMathBenchmark() times both on the target.
+//
+
+#ifndef MOD_MATH_H
+#define MOD_MATH_H
+
+#include <Arduino.h>
+
+//floor(fraction / 2^32 * depth), the L ramp (fraction = phase) and S sine sample offset
+int64_t q32Scale(uint32_t fraction, int32_t depth);
+//floor(sample / 2^31 * depth), the custom waveform offset
+int64_t q31Scale(int32_t sample, int32_t depth);
+//O triangle offset at phase, rising to 2 * depth at half a cycle
+int64_t triangleOffset(uint32_t phase, int32_t depth);
+//floor(value * fraction / 2^32) for any 64 bit value, the glide position (glide.cpp)
+int64_t q32Mul(int64_t value, uint32_t fraction);
+
+//Times count evaluations of the LFO offsets in fixed point and with the
+//previous double arithmetic, in DWT cycles per evaluation. Returns the number of
+//evaluations where the two differ
+uint32_t modMathBenchmark(uint16_t count, uint32_t &fixed_cycles, uint32_t &double_cycles);
+
+#endif
@@ -0,0 +1,141 @@
+//
+//  mod_scheduler.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Fixed rate modulation output using a hardware timer interrupt.
+// The two frame slots alternate: the main loop fills writeSlot_ while the interrupt
+// may still be due to write readSlot_, and ready_ hands a filled slot over.
+//
+
+#include <Arduino.h>
+#include "brd_ltdz_stm32f103cb.h"
+#include "mod_scheduler.h"
+
+static HardwareTimer *modTimer = NULL;
+static ModScheduler *activeScheduler = NULL;
+
+static void modTimerISR()
+{
+  activeScheduler->tick();
+}
+
+bool ModScheduler::start(uint32_t rate_hz)
+{
+  if (rate_hz < 1 || rate_hz > MOD_RATE_MAX_HZ) {
+    return false;
+  }
+  if (modTimer == NULL) {
+    modTimer = new HardwareTimer(MOD_TIMER);
+    modTimer->attachInterrupt(modTimerISR);
+  }
+  activeScheduler = this;
+  modTimer->pause();
+  flush();
+  modTimer->setOverflow(rate_hz, HERTZ_FORMAT);
+  rate_ = rate_hz;
+  modTimer->resume();
+  return true;
+}
+
+void ModScheduler::stop()
+{
+  if (modTimer != NULL) {
+    modTimer->pause();
+  }
+  rate_ = 0;
+  flush();
+}
+
+ModFrame &ModScheduler::slot(uint8_t kind)
+{
+  ModFrame &f = frames_[writeSlot_];
+  f.kind = kind;
+  return f;
+}
+
+void ModScheduler::publish()
+{
+  __DMB(); //frame contents before ready_
+  readSlot_ = writeSlot_;
+  ready_ = true;
+  primed_ = true;
+  writeSlot_ ^= 1;
+}
+
+void ModScheduler::queuePlan(const PLLPlan &p)
+{
+  slot(MOD_FRAME_PLAN).plan = p;
+  publish();
+}
+
+void ModScheduler::queueTable(uint16_t index)
+{
+  slot(MOD_FRAME_TABLE).index = index;
+  publish();
+}
+
+void ModScheduler::queueHold()
+{
+  slot(MOD_FRAME_HOLD);
+  publish();
+}
+
+void ModScheduler::queueLock()
+{
+  slot(MOD_FRAME_LOCK);
+  publish();
+}
+
+void ModScheduler::flush()
+{
+  noInterrupts();
+  ready_ = false;
+  primed_ = false;
+  interrupts();
+}
+
+void ModScheduler::lock()
+{
+  NVIC_DisableIRQ(MOD_TIMER_IRQn);
+  __DSB();
+  __ISB();
+}
+
+void ModScheduler::unlock()
+{
+  NVIC_EnableIRQ(MOD_TIMER_IRQn);
+}
+
+void ModScheduler::tick()
+{
+  if (!ready_) {
+    if (primed_) {
+      overruns++;
+    }
+    return;
+  }
+  const ModFrame &f = frames_[readSlot_];
+  switch (f.kind) {
+    case MOD_FRAME_PLAN:
+      vfo_.setPlan(f.plan);
+      break;
+    case MOD_FRAME_TABLE:
+      table_.play(vfo_, f.index);
+      break;
+    case MOD_FRAME_LOCK:
+      vfo_.lock_freq();
+      break;
+    default:
+      break;
+  }
+  ready_ = false;
+  frames++;
+}
@@ -0,0 +1,91 @@
+//
+//  mod_scheduler.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Fixed rate modulation output using a hardware timer interrupt.
+// The main loop calculates the next modulation step into a free frame slot and the
+// timer interrupt writes one frame to the ADF4351 per tick, so the output rate does
+// not depend on the planner cost, SPI time or serial traffic. A tick that finds no
+// frame ready is counted as an overrun.
+//
+
+#ifndef MOD_SCHEDULER_H
+#define MOD_SCHEDULER_H
+
+#include <Arduino.h>
+#include "adf4351.h"
+#include "reg_table.h"
+
+#define MOD_RATE_MAX_HZ  20000 ///< Highest modulation sample rate accepted by start()
+
+#define MOD_FRAME_HOLD   0 ///< keep the current registers
+#define MOD_FRAME_PLAN   1 ///< write a solved plan
+#define MOD_FRAME_TABLE  2 ///< play a RegTable entry
+#define MOD_FRAME_LOCK   3 ///< enable cycle slip reduction once the frequency settles
+
+struct ModFrame
+{
+  uint8_t kind ;
+  uint16_t index ;  ///< RegTable entry for MOD_FRAME_TABLE
+  PLLPlan plan ;    ///< plan for MOD_FRAME_PLAN
+};
+
+class ModScheduler
+{
+  public:
+    ModScheduler(ADF4351 &vfo, RegTable &table)
+      : frames(0), overruns(0), vfo_(vfo), table_(table), rate_(0), ready_(false),
+        primed_(false), writeSlot_(0), readSlot_(0) { }
+
+    //Start the timer at rate_hz (1 to MOD_RATE_MAX_HZ), returns false if out of range
+    bool start(uint32_t rate_hz);
+    //Stop the timer, the main loop then writes each step as soon as it is calculated
+    void stop();
+    bool running() const { return rate_ != 0; }
+    uint32_t rate() const { return rate_; }
+
+    //True when a frame slot is free for the next step (always true when stopped)
+    bool wantsFrame() const { return rate_ == 0 || !ready_; }
+
+    //Fill the free slot and hand it to the timer interrupt
+    void queuePlan(const PLLPlan &p);
+    void queueTable(uint16_t index);
+    void queueHold();
+    void queueLock();
+
+    //Drop any queued frame, ticks are not counted as overruns until the next queue
+    void flush();
+
+    //Hold off the timer interrupt while the main loop writes the ADF4351 itself
+    void lock();
+    void unlock();
+
+    //Timer interrupt handler, writes the queued frame
+    void tick();
+
+    volatile uint32_t frames ;   ///< frames written by the timer interrupt
+    volatile uint32_t overruns ; ///< ticks where the next frame was not ready
+
+  private:
+    ModFrame &slot(uint8_t kind);
+    void publish();
+
+    ADF4351 &vfo_;
+    RegTable &table_;
+    uint32_t rate_;
+    volatile bool ready_;  ///< frames_[readSlot_] is waiting for the next tick
+    volatile bool primed_; ///< a frame has been queued since the last flush()
+    uint8_t writeSlot_;
+    volatile uint8_t readSlot_;
+    ModFrame frames_[2];
+};
+
+#endif
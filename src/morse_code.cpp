@@ -163,12 +163,11 @@ void appendMorseChar(char c, String& morseString) {
 }
 
 
-String writeMorseString(const String& inputString) {
-    size_t length = inputString.length();
+String writeMorseString(const char* inputString) {
     String morseString;
 
-    for (size_t i = 0; i < length; i++) {
-        appendMorseChar(inputString[i], morseString);
+    for (const char* p = inputString; *p != 0; p++) {
+        appendMorseChar(*p, morseString);
     }
     return morseString;
 }
@@ -216,9 +215,7 @@ void interactiveMorseCode(void (*RF_enable_Func)(), void (*RF_disable_Func)(), i
             if (c == 27) {  // ASCII code for escape key
                 escapKeyPressed=true;
             } else {
-                String command;
-                // Append character to morseString
-                command += c;
+                char command[2] = { c, 0 };
                 // Process morseString
                 String morseString = writeMorseString(command);
                 processMorseString(morseString,RF_enable_Func,RF_disable_Func,wpm,false);
@@ -20,7 +20,7 @@
 void appendMorseChar(char c, String& morseString);
 
 //Form an output string of morse code from an input ascii string
-String writeMorseString(const String& inputString);
+String writeMorseString(const char* inputString);
 
 //Parse a morse string of . - and space at a given wpm rate and call the two functions to control morse key operation
 void processMorseString(const String& morseString, void (*RF_enable_Func)(), void (*RF_disable_Func)(), int gap = 20, bool line_end=true);
@@ -0,0 +1,76 @@
+//
+//  profiler.cpp
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Retune pipeline profiling with the DWT cycle counter. The counter is
+// enabled in setup(). Updates mask interrupts so a stage shared by the main loop and
+// the timer or trigger interrupts stays consistent.
+//
+
+#include <Arduino.h>
+#include "profiler.h"
+
+Profiler profiler;
+
+static const char *const stageNames[PROF_STAGES] = {
+  "Parse", "Plan", "Plan failed", "Delta FRAC", "Encode", "SPI write", "Lock"
+};
+
+void Profiler::record(uint8_t stage, uint32_t cycles)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  ProfStage &s = stages_[stage];
+  if (cycles < s.min) {
+    s.min = cycles;
+  }
+  if (cycles > s.max) {
+    s.max = cycles;
+  }
+  s.sum += cycles;
+  s.count++;
+  __set_PRIMASK(primask);
+}
+
+void Profiler::reset()
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  for (uint8_t i = 0; i < PROF_STAGES; i++) {
+    stages_[i].count = 0;
+    stages_[i].min = 0xFFFFFFFFUL;
+    stages_[i].max = 0;
+    stages_[i].sum = 0;
+  }
+  __set_PRIMASK(primask);
+}
+
+ProfStage Profiler::get(uint8_t stage) const
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  ProfStage s = stages_[stage];
+  __set_PRIMASK(primask);
+  if (s.count == 0) {
+    s.min = 0;
+  }
+  return s;
+}
+
+const char *Profiler::name(uint8_t stage)
+{
+  return stage < PROF_STAGES ? stageNames[stage] : "";
+}
+
+uint32_t Profiler::ns(uint64_t cycles)
+{
+  return cycles * 1000ULL / (F_CPU / 1000000UL);
+}
@@ -0,0 +1,65 @@
+//
+//  profiler.h
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Retune pipeline profiling with the DWT cycle counter. Each stage of a
+// frequency change (command parse, planning, register encoding, SPI write and lock)
+// records its cycle count, and the count, min, max and mean of each stage are kept
+// until reset. record() may be called from interrupts as well as the main loop.
+//
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+
+#define PROF_PARSE     0 ///< command line tokenize (text and binary)
+#define PROF_PLAN      1 ///< solving a frequency into a plan, cache hits included
+#define PROF_PLAN_FAIL 2 ///< frequencies that could not be solved
+#define PROF_FRAC      3 ///< small step INT/FRAC/MOD update (ADF4351::retuneFrac)
+#define PROF_ENCODE    4 ///< plan to register words
+#define PROF_SPI       5 ///< writing the changed registers (queueing only with USE_DMA_SPI)
+#define PROF_LOCK      6 ///< R0 latch to the lock detect edge (lock_detect.cpp)
+#define PROF_STAGES    7
+
+struct ProfStage
+{
+  uint32_t count ;
+  uint32_t min ;
+  uint32_t max ;
+  uint64_t sum ;
+};
+
+class Profiler
+{
+  public:
+    Profiler() { reset(); }
+
+    //Cycle counter value to pass to end()
+    static uint32_t start() { return DWT->CYCCNT; }
+    //Record the cycles since start for stage
+    void end(uint8_t stage, uint32_t start) { record(stage, DWT->CYCCNT - start); }
+    void record(uint8_t stage, uint32_t cycles);
+
+    void reset();
+    //Consistent copy of one stage
+    ProfStage get(uint8_t stage) const;
+    static const char *name(uint8_t stage);
+    //Cycles to ns at F_CPU
+    static uint32_t ns(uint64_t cycles);
+
+  private:
+    ProfStage stages_[PROF_STAGES];
+};
+
+extern Profiler profiler;
+
+#endif
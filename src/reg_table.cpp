@@ -0,0 +1,100 @@
+//
+//  reg_table.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Table of pre-solved ADF4351 register words for fast playback.
+//
+
+#include <Arduino.h>
+#include "reg_table.h"
+#include "adf4351_fields.h"
+
+//R1-R4 bits written by ADF4351::encodePlan() that depend on the plan, apart from MOD.
+//The remaining bits are configuration (phase, power, R counter...) and are left alone
+static const uint32_t planMask[4] = {
+  Adf::Prescaler::mask,                                            // R1
+  Adf::LDP::mask | Adf::LDF::mask,                                 // R2
+  Adf::ChargeCancel::mask | Adf::ABP::mask | Adf::CSR::mask,       // R3
+  Adf::RFDivSel::mask                                              // R4
+};
+
+void RegTable::clear()
+{
+  count_ = 0;
+  palettes_ = 0;
+}
+
+bool RegTable::add(ADF4351 &vfo, const PLLPlan &p)
+{
+  if (count_ >= REG_TABLE_SIZE || !encode(vfo, p, count_)) {
+    return false;
+  }
+  count_++;
+  return true;
+}
+
+bool RegTable::set(ADF4351 &vfo, const PLLPlan &p, uint16_t index)
+{
+  return index < count_ && encode(vfo, p, index);
+}
+
+bool RegTable::encode(ADF4351 &vfo, const PLLPlan &p, uint16_t index)
+{
+  Reg regs[6];
+  for (uint8_t i = 0; i < 6; i++) {
+    regs[i].whole = vfo.R[i].whole;
+  }
+  vfo.encodePlan(p, regs);
+
+  uint32_t fields[4];
+  for (uint8_t i = 0; i < 4; i++) {
+    fields[i] = regs[i + 1].whole & planMask[i];
+  }
+  uint8_t n = 0;
+  while (n < palettes_ && memcmp(fields_[n], fields, sizeof(fields)) != 0) {
+    n++;
+  }
+  if (n == palettes_) {
+    if (palettes_ >= REG_TABLE_PALETTE) {
+      return false;
+    }
+    memcpy(fields_[n], fields, sizeof(fields));
+    palettes_++;
+  }
+  r0_[index] = regs[0].whole | ((uint32_t)(n >> 4) << 31);
+  r1_[index] = Adf::ModValue::get(regs) | ((n & 0x0F) << 12);
+  return true;
+}
+
+void RegTable::get(uint16_t index, Reg *regs) const
+{
+  const uint16_t r1 = r1_[index];
+  const uint32_t r0 = r0_[index];
+  const uint32_t *fields = fields_[(r1 >> 12) | ((r0 >> 31) << 4)];
+  regs[0].whole = r0 & 0x7FFFFFFFUL;
+  for (uint8_t i = 0; i < 4; i++) {
+    regs[i + 1].whole = fields[i];
+  }
+  Adf::ModValue::set(regs, r1 & 0x0FFF);
+}
+
+void RegTable::play(ADF4351 &vfo, uint16_t index)
+{
+  const uint16_t r1 = r1_[index];
+  const uint32_t r0 = r0_[index];
+  const uint32_t *fields = fields_[(r1 >> 12) | ((r0 >> 31) << 4)];
+  vfo.R[0].whole = r0 & 0x7FFFFFFFUL;
+  for (uint8_t i = 0; i < 4; i++) {
+    vfo.R[i + 1].whole = (vfo.R[i + 1].whole & ~planMask[i]) | fields[i];
+  }
+  Adf::ModValue::set(vfo.R, r1 & 0x0FFF);
+  vfo.writeChanged();
+}
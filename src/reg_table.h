@@ -0,0 +1,73 @@
+//
+//  reg_table.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Table of pre-solved ADF4351 register words for fast playback.
+// Each entry holds the R0 word, the 12 bit MOD value and a 5 bit index into a small
+// palette of the other plan dependent R1-R4 fields (prescaler, int/frac-n mode bits
+// and output divider), which only change when a sequence crosses a band boundary.
+// 32 palette entries cover every divider, prescaler and int/frac-n combination, so
+// a table can span the whole 35 MHz to 4.4 GHz range.
+// Playing an entry loads the words into vfo.R and writes the registers that changed,
+// so no PLL arithmetic is needed at playback time.
+//
+
+#ifndef REG_TABLE_H
+#define REG_TABLE_H
+
+#include <Arduino.h>
+#include "adf4351.h"
+
+#define REG_TABLE_SIZE     1024 ///< Maximum number of entries (6 bytes RAM each)
+#define REG_TABLE_PALETTE  32   ///< Maximum number of distinct R1-R4 settings
+
+//Users of a table, one table is shared by the LFO, sweep and hop list to save RAM
+#define REG_TABLE_LFO    0
+#define REG_TABLE_SWEEP  1
+#define REG_TABLE_HOP    2
+
+class RegTable
+{
+  public:
+    RegTable() : user(REG_TABLE_LFO), count_(0), palettes_(0) { }
+
+    //Remove all entries
+    void clear();
+
+    //Encode a plan against the current vfo settings and append it,
+    //returns false if the table or the palette is full
+    bool add(ADF4351 &vfo, const PLLPlan &p);
+
+    //Replace entry index with a new plan, returns false if the palette is full
+    bool set(ADF4351 &vfo, const PLLPlan &p, uint16_t index);
+
+    //Load entry index into vfo.R and write the changed registers
+    void play(ADF4351 &vfo, uint16_t index);
+
+    //R0 and the plan dependent R1-R4 fields of entry index, other bits are 0
+    void get(uint16_t index, Reg *regs) const;
+
+    uint16_t size() const { return count_; }
+    uint8_t palettes() const { return palettes_; }
+
+    uint8_t user; ///< REG_TABLE_ user that filled the entries
+
+  private:
+    bool encode(ADF4351 &vfo, const PLLPlan &p, uint16_t index);
+
+    uint32_t r0_[REG_TABLE_SIZE];           ///< R0, palette index bit 4 in the reserved bit 31
+    uint16_t r1_[REG_TABLE_SIZE];           ///< MOD in bits 0-11, palette index bits 0-3 in bits 12-15
+    uint32_t fields_[REG_TABLE_PALETTE][4]; ///< masked R1-R4 values
+    uint16_t count_;
+    uint8_t palettes_;
+};
+
+#endif
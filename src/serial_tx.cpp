@@ -0,0 +1,88 @@
+//
+//  serial_tx.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Non blocking serial output queues for the USB CDC and USART ports.
+//
+
+#include <Arduino.h>
+#include "brd_ltdz_stm32f103cb.h"
+#include "serial_tx.h"
+
+SerialTx serialTx;
+
+bool TxQueue::put(const uint8_t *buf, size_t n)
+{
+  if (n > SERIAL_TX_QUEUE_SIZE - used()) {
+    dropped += n;
+    return false;
+  }
+  while (n--) {
+    buf_[head_++ & (SERIAL_TX_QUEUE_SIZE - 1)] = *buf++;
+  }
+  return true;
+}
+
+void TxQueue::drain(Print &port)
+{
+  while (used() > 0) {
+    int room = port.availableForWrite();
+    if (room <= 0) {
+      return;
+    }
+    //Largest piece that does not wrap around the end of the buffer
+    uint16_t start = tail_ & (SERIAL_TX_QUEUE_SIZE - 1);
+    size_t n = SERIAL_TX_QUEUE_SIZE - start;
+    if (n > used()) {
+      n = used();
+    }
+    if (n > (size_t)room) {
+      n = room;
+    }
+    n = port.write(&buf_[start], n);
+    if (n == 0) {
+      return;
+    }
+    tail_ += n;
+  }
+}
+
+size_t SerialTx::write(const uint8_t *buf, size_t n)
+{
+#ifdef USE_USB_SERIAL
+  if (route & SERIAL_PORT_USB) {
+    if (n > SERIAL_TX_QUEUE_SIZE - usb.used()) {
+      usb.drain(SerialUSB); //Make room if the driver can take some
+    }
+    usb.put(buf, n);
+  }
+#endif
+#ifdef USE_HARDWARE_SERIAL
+  if (route & SERIAL_PORT_UART) {
+    if (n > SERIAL_TX_QUEUE_SIZE - uart.used()) {
+      uart.drain(Serial2);
+    }
+    uart.put(buf, n);
+  }
+#endif
+  service();
+  return n;
+}
+
+void SerialTx::service()
+{
+#ifdef USE_USB_SERIAL
+  usb.drain(SerialUSB);
+#endif
+#ifdef USE_HARDWARE_SERIAL
+  uart.drain(Serial2);
+#endif
+}
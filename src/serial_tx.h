@@ -0,0 +1,68 @@
+//
+//  serial_tx.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Non blocking serial output. Text replies are queued per port and moved into
+// the USB CDC and USART drivers only as fast as they have room, the drivers then send them
+// from their own interrupts. A full queue drops the write and counts it instead of
+// stalling the modulation loop.
+//
+
+#ifndef SERIAL_TX_H
+#define SERIAL_TX_H
+
+#include <Arduino.h>
+
+#define SERIAL_TX_QUEUE_SIZE 2048 ///< Bytes queued per port, a power of 2 that holds the H reply
+
+#define SERIAL_PORT_USB  0x01
+#define SERIAL_PORT_UART 0x02
+#define SERIAL_PORT_ALL  (SERIAL_PORT_USB | SERIAL_PORT_UART)
+
+//Ring buffer of bytes waiting for one port
+class TxQueue
+{
+  public:
+    TxQueue() : dropped(0), head_(0), tail_(0) {}
+
+    //Queue n bytes, all or nothing. Returns false and counts the bytes as dropped if they do not fit
+    bool put(const uint8_t *buf, size_t n);
+    //Move as many queued bytes as the driver has room for into port, never blocks
+    void drain(Print &port);
+    size_t used() const { return (uint16_t)(head_ - tail_); }
+
+    uint32_t dropped; ///< bytes dropped because the queue was full
+
+  private:
+    uint8_t buf_[SERIAL_TX_QUEUE_SIZE];
+    uint16_t head_; ///< free running write count
+    uint16_t tail_; ///< free running read count
+};
+
+//Print target for the Serial_print macros, writes to the queues of the ports in route
+class SerialTx : public Print
+{
+  public:
+    SerialTx() : route(SERIAL_PORT_ALL) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t n) override;
+    //Push queued output into the drivers, called from the main loop and after every write
+    void service();
+
+    uint8_t route; ///< SERIAL_PORT_ mask of the current command session, readSerialData() reads from it too
+    TxQueue usb;
+    TxQueue uart;
+};
+
+extern SerialTx serialTx;
+
+#endif
@@ -0,0 +1,192 @@
+//
+//  sweep.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: On-device stepped frequency sweep played from a RegTable by SWEEP_TIMER.
+//
+// With lock gating a step only counts as locked on a fresh lock detect edge after its
+// own R0 latch (PIN_LD is still high from the previous step right after the write). The
+// LockDetect edge interrupt restarts the timer count, so the full dwell is spent locked.
+// Until then the timer is set to come back at SWEEP_LOCK_TIMEOUT_US, when the dwell
+// starts anyway and the step counts as a lock timeout, so neither interrupt waits.
+//
+
+#include <Arduino.h>
+#include "brd_ltdz_stm32f103cb.h"
+#include "sweep.h"
+
+#define CYCLES_PER_US (F_CPU / 1000000UL)
+
+static HardwareTimer *sweepTimer = NULL;
+static Sweep *activeSweep = NULL;
+
+static void sweepTimerISR()
+{
+  activeSweep->tick();
+}
+
+static void sweepLockISR()
+{
+  activeSweep->locked();
+}
+
+uint16_t Sweep::build(uint64_t from, uint64_t to, uint64_t step)
+{
+  stop();
+  table_.clear();
+  table_.user = REG_TABLE_SWEEP;
+  if (step == 0) {
+    step = 1;
+  }
+  uint64_t span = from > to ? from - to : to - from;
+  if (span / step >= REG_TABLE_SIZE) {
+    return 0;
+  }
+  uint16_t count = span / step + 1;
+  for (uint16_t i = 0; i < count; i++) {
+    uint64_t f = from > to ? from - i * step : from + i * step;
+    PLLPlan p;
+    if (vfo_.plan(f, p) != 0 || !table_.add(vfo_, p)) {
+      table_.clear();
+      return 0;
+    }
+  }
+  return count;
+}
+
+bool Sweep::start(uint32_t dwell_us, bool lockGate, bool repeat)
+{
+  if (dwell_us < SWEEP_DWELL_MIN_US || dwell_us > SWEEP_DWELL_MAX_US || table_.size() == 0) {
+    return false;
+  }
+  if (sweepTimer == NULL) {
+    sweepTimer = new HardwareTimer(SWEEP_TIMER);
+    sweepTimer->attachInterrupt(sweepTimerISR);
+  }
+  activeSweep = this;
+  sweepTimer->pause();
+  lock_.onLock = sweepLockISR;
+  lockGate_ = lockGate;
+  repeat_ = repeat;
+  gated_ = false;
+  dwellUs_ = dwell_us;
+  steps = 0;
+  lockTimeouts = 0;
+  done_ = false;
+  startUs_ = micros();
+  sweepTimer->setOverflow(dwell_us, MICROSEC_FORMAT);
+  sweepTimer->setCount(0);
+  play(0);
+  running_ = true;
+  sweepTimer->resume();
+  return true;
+}
+
+void Sweep::stop()
+{
+  if (sweepTimer != NULL) {
+    sweepTimer->pause();
+  }
+  if (running_) {
+    endUs_ = micros();
+    running_ = false;
+  }
+}
+
+void Sweep::finish()
+{
+  sweepTimer->pause();
+  endUs_ = micros();
+  running_ = false;
+  done_ = true;
+}
+
+bool Sweep::finished()
+{
+  if (!done_) {
+    return false;
+  }
+  done_ = false;
+  return true;
+}
+
+uint32_t Sweep::stepsPerSecond() const
+{
+  uint32_t us = (running_ ? micros() : endUs_) - startUs_;
+  if (us == 0) {
+    return 0;
+  }
+  return (uint64_t)steps * 1000000ULL / us;
+}
+
+void Sweep::lock()
+{
+  NVIC_DisableIRQ(SWEEP_TIMER_IRQn);
+  __DSB();
+  __ISB();
+}
+
+void Sweep::unlock()
+{
+  NVIC_EnableIRQ(SWEEP_TIMER_IRQn);
+}
+
+void Sweep::play(uint16_t i)
+{
+  index = i;
+  playCycles_ = DWT->CYCCNT;
+  gated_ = lockGate_;
+  //Come back at the lock timeout unless locked() restarts the dwell first
+  if (gated_ && dwellUs_ > SWEEP_LOCK_TIMEOUT_US) {
+    sweepTimer->setCount(dwellUs_ - SWEEP_LOCK_TIMEOUT_US, MICROSEC_FORMAT);
+  }
+  table_.play(vfo_, i);
+  steps++;
+  if (gated_ && (vfo_.lastWriteMask & 1) == 0) {
+    gated_ = false; //R0 unchanged, no retune to wait for
+    sweepTimer->setCount(0);
+  }
+}
+
+void Sweep::locked()
+{
+  //Only an edge from a latch of the current step, not one still pending from before it
+  if (!running_ || !gated_ || lock_.latchCycles() - playCycles_ >= 0x80000000UL) {
+    return;
+  }
+  gated_ = false;
+  sweepTimer->setCount(0); //Dwell from lock
+}
+
+void Sweep::tick()
+{
+  if (!running_) {
+    return;
+  }
+  if (gated_) {
+    //A dwell shorter than the timeout comes round again until it has passed
+    if (DWT->CYCCNT - playCycles_ < SWEEP_LOCK_TIMEOUT_US * CYCLES_PER_US) {
+      return;
+    }
+    gated_ = false;
+    lockTimeouts++;
+    return; //Dwell from the timeout, the count has just restarted
+  }
+  uint16_t next = index + 1;
+  if (next >= table_.size()) {
+    if (!repeat_) {
+      finish(); //The last step stays on the output
+      return;
+    }
+    next = 0;
+  }
+  play(next);
+}
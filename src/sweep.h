@@ -0,0 +1,89 @@
+//
+//  sweep.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: On-device stepped frequency sweep. Every step is solved into a RegTable
+// up front, then a hardware timer interrupt plays one entry per dwell period, so a step
+// costs only the changed register writes. Optionally each dwell starts at the lock
+// detect edge of the step instead of at the register write.
+//
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <Arduino.h>
+#include "adf4351.h"
+#include "reg_table.h"
+#include "lock_detect.h"
+
+#define SWEEP_DWELL_MIN_US    50        ///< Shortest dwell accepted by start()
+#define SWEEP_DWELL_MAX_US    10000000  ///< Longest dwell accepted by start() (10 s)
+#define SWEEP_LOCK_TIMEOUT_US 2000      ///< Longest wait for the lock edge before a dwell starts anyway
+
+class Sweep
+{
+  public:
+    Sweep(ADF4351 &vfo, RegTable &table, LockDetect &lock)
+      : steps(0), lockTimeouts(0), index(0), vfo_(vfo), table_(table), lock_(lock), running_(false),
+        done_(false), lockGate_(false), repeat_(false), gated_(false), dwellUs_(0), playCycles_(0),
+        startUs_(0), endUs_(0) { }
+
+    //Solve the frequencies between from and to (both included) in step Hz into the table,
+    //returns the number of steps or 0 if a step can not be solved or there are
+    //more than REG_TABLE_SIZE
+    uint16_t build(uint64_t from, uint64_t to, uint64_t step);
+
+    //Write the first step and then the next one every dwell_us, returns false if the
+    //dwell is out of range or nothing has been built. lockGate starts each dwell at the
+    //lock detect edge of the step, repeat restarts from the first step instead of stopping
+    bool start(uint32_t dwell_us, bool lockGate, bool repeat);
+    void stop();
+    bool running() const { return running_; }
+
+    //True once when a single pass has completed
+    bool finished();
+
+    //Steps per second achieved by the current or last run
+    uint32_t stepsPerSecond() const;
+    uint16_t size() const { return table_.size(); }
+
+    //Hold off the timer interrupt while the main loop writes the ADF4351 itself
+    void lock();
+    void unlock();
+
+    //Timer interrupt handler, moves to the next step
+    void tick();
+    //Lock detect edge interrupt handler, starts the dwell of a gated step
+    void locked();
+
+    volatile uint32_t steps ;        ///< steps written since start()
+    volatile uint32_t lockTimeouts ; ///< steps with no lock edge within SWEEP_LOCK_TIMEOUT_US
+    volatile uint16_t index ;        ///< table entry being played
+
+  private:
+    void play(uint16_t i);
+    void finish();
+
+    ADF4351 &vfo_;
+    RegTable &table_;
+    LockDetect &lock_;
+    volatile bool running_;
+    volatile bool done_;
+    bool lockGate_;
+    bool repeat_;
+    volatile bool gated_;  ///< the step was written, its dwell waits for the lock edge
+    uint32_t dwellUs_;
+    uint32_t playCycles_;  ///< DWT->CYCCNT when the gated step was written
+    uint32_t startUs_;
+    volatile uint32_t endUs_;
+};
+
+#endif
@@ -0,0 +1,210 @@
+//
+//  uart_dma.cpp
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Serial2 receive through DMA1 channel 6 into a circular buffer.
+//
+// The DMA write position is read from CNDTR when the command loop polls. The only
+// receive interrupts are the DMA half and full transfer ones, two per lap of the buffer,
+// which count laps so the number of bytes written is known even when the command loop
+// falls more than a buffer behind. Bytes the DMA overwrote before they were read are
+// dropped and reported by uartDmaLost() instead of being parsed. The core keeps the
+// USART2 interrupt for transmit, so the HAL receive and error interrupts are switched
+// off rather than replaced with an idle line handler.
+//
+
+#include <Arduino.h>
+#include "brd_ltdz_stm32f103cb.h"
+#include "uart_dma.h"
+
+static uint8_t rxBuf[UART_RX_SIZE];
+static volatile uint32_t rxHalves = 0; ///< DMA half and full transfer interrupts
+static uint32_t rxRead = 0;            ///< bytes taken from rxBuf, counted as rxWritten()
+static uint32_t rxLost = 0;            ///< bytes dropped since the last uartDmaLost()
+static uint32_t baudRate = 0;
+static uint32_t baudPrevious = 0;
+static uint32_t baudSwitchMs = 0;
+static bool baudPending = false;
+
+static uint16_t rxHead()
+{
+  return (UART_RX_SIZE - DMA1_Channel6->CNDTR) & (UART_RX_SIZE - 1);
+}
+
+extern "C" void DMA1_Channel6_IRQHandler(void)
+{
+  uint32_t isr = DMA1->ISR;
+  DMA1->IFCR = DMA_IFCR_CGIF6;
+  rxHalves += ((isr & DMA_ISR_HTIF6) != 0) + ((isr & DMA_ISR_TCIF6) != 0);
+}
+
+//Bytes written by the DMA since uartDmaBegin(), wrapping at 2^32
+static uint32_t rxWritten()
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t halves = rxHalves;
+  uint16_t head = rxHead();
+  __set_PRIMASK(primask);
+  //The count is behind by one when the half the DMA is in has not had its interrupt
+  //yet, correct while the interrupt is held off for less than half the buffer
+  if ((halves & 1) != (head >= UART_RX_SIZE / 2)) {
+    halves++;
+  }
+  return (halves >> 1) * UART_RX_SIZE + head;
+}
+
+//Unread bytes, dropping them all if the DMA has lapped the reader
+static uint32_t rxPending()
+{
+  uint32_t written = rxWritten();
+  uint32_t pending = written - rxRead;
+  if (pending > UART_RX_SIZE) {
+    rxLost += pending;
+    rxRead = written;
+    return 0;
+  }
+  return pending;
+}
+
+void uartDmaBegin(uint32_t baud)
+{
+  Serial2.begin(baud);
+  baudRate = baud;
+
+  //Take the receiver away from the HAL interrupt handler
+  USART2->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_PEIE);
+  USART2->CR3 &= ~USART_CR3_EIE;
+
+  //DMA1 channel 6 (USART2_RX): 8 bit USART2->DR to rxBuf, circular, interrupts at
+  //each half to count laps. Lowest priority, rxWritten() allows for a late one
+  RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+  DMA1_Channel6->CCR = 0;
+  DMA1->IFCR = DMA_IFCR_CGIF6;
+  DMA1_Channel6->CPAR = (uint32_t)&USART2->DR;
+  DMA1_Channel6->CMAR = (uint32_t)rxBuf;
+  DMA1_Channel6->CNDTR = UART_RX_SIZE;
+  rxHalves = 0;
+  rxRead = 0;
+  rxLost = 0;
+  NVIC_SetPriority(DMA1_Channel6_IRQn, 15);
+  NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+  DMA1_Channel6->CCR = DMA_CCR_PL_1 | DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_EN;
+  USART2->CR3 |= USART_CR3_DMAR;
+}
+
+//Baud rate divider for baud, 0 if the rate can not be made within 2%
+static uint32_t divider(uint32_t baud)
+{
+  if (baud < UART_BAUD_MIN || baud > UART_BAUD_MAX) {
+    return 0;
+  }
+  uint32_t pclk = HAL_RCC_GetPCLK1Freq();
+  uint32_t brr = (pclk + baud / 2) / baud;
+  if (brr < 16 || brr > 0xFFFF) {
+    return 0;
+  }
+  uint32_t actual = pclk / brr;
+  uint32_t err = actual > baud ? actual - baud : baud - actual;
+  if (err * 50 > baud) {
+    return 0;
+  }
+  return brr;
+}
+
+static bool setDivider(uint32_t baud)
+{
+  uint32_t brr = divider(baud);
+  if (brr == 0) {
+    return false;
+  }
+  USART2->CR1 &= ~USART_CR1_UE;
+  USART2->BRR = brr;
+  USART2->CR1 |= USART_CR1_UE;
+  return true;
+}
+
+//Reverts an unconfirmed baud rate switch, called while polling for input
+static void baudService()
+{
+  if (!baudPending) {
+    return;
+  }
+  if (rxWritten() != rxRead) {
+    baudPending = false; //The host is talking at the new rate
+  } else if (millis() - baudSwitchMs > UART_BAUD_CONFIRM_MS) {
+    baudPending = false;
+    if (setDivider(baudPrevious)) {
+      baudRate = baudPrevious;
+    }
+  }
+}
+
+int uartDmaAvailable()
+{
+  baudService();
+  return rxPending();
+}
+
+int uartDmaRead()
+{
+  if (rxPending() == 0) {
+    return -1;
+  }
+  uint8_t c = rxBuf[rxRead & (UART_RX_SIZE - 1)];
+  //The DMA may have come round to the byte while it was being read
+  if (rxWritten() - rxRead > UART_RX_SIZE) {
+    rxPending();
+    return -1;
+  }
+  rxRead++;
+  return c;
+}
+
+uint32_t uartDmaLost()
+{
+  uint32_t lost = rxLost;
+  rxLost = 0;
+  return lost;
+}
+
+bool uartDmaBaudValid(uint32_t baud)
+{
+  return divider(baud) != 0;
+}
+
+bool uartDmaSetBaud(uint32_t baud, bool confirm)
+{
+  if (!uartDmaBaudValid(baud)) {
+    return false;
+  }
+  //Send the reply at the old rate first
+  uint32_t start = millis();
+  while (serialTx.uart.used() > 0 && millis() - start < 1000) {
+    serialTx.service();
+  }
+  Serial2.flush();
+  uint32_t previous = baudRate;
+  if (!setDivider(baud)) {
+    return false;
+  }
+  baudRate = baud;
+  baudPrevious = previous;
+  baudSwitchMs = millis();
+  baudPending = confirm;
+  rxRead = rxWritten(); //Bytes received during the switch are garbage
+  return true;
+}
+
+uint32_t uartDmaBaud()
+{
+  return baudRate;
+}
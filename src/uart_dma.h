@@ -0,0 +1,52 @@
+//
+//  uart_dma.h
+//  
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//  
+//  License: MIT License
+//
+// Description: Serial2 (USART2, PA3 RX / PA2 TX) receive through DMA1 channel 6 into a
+// circular buffer, so received bytes cost no interrupts, only two per lap of the buffer
+// to count laps and detect overruns. Transmit stays with the Serial2 driver. The baud rate can be switched on the fly up to UART_BAUD_MAX.
+//
+
+#ifndef UART_DMA_H
+#define UART_DMA_H
+
+#include <Arduino.h>
+
+#define UART_RX_SIZE 1024         ///< DMA receive buffer, a power of 2 (5 ms at 2 Mbaud)
+#define UART_BAUD_MIN 1200
+#define UART_BAUD_MAX 2250000     ///< APB1 36 MHz / 16
+#define UART_BAUD_CONFIRM_MS 2000 ///< A switch requested over the UART reverts if nothing arrives at the new rate
+
+//Start Serial2 at baud and hand its receiver to the DMA channel
+void uartDmaBegin(uint32_t baud);
+
+//Number of received bytes waiting
+int uartDmaAvailable();
+
+//Next received byte, -1 if there is none
+int uartDmaRead();
+
+//Bytes dropped since the last call because the command loop fell more than
+//UART_RX_SIZE behind and the DMA overwrote them before they were read
+uint32_t uartDmaLost();
+
+//True if baud is within UART_BAUD_MIN to UART_BAUD_MAX and the divider error is under 2%
+bool uartDmaBaudValid(uint32_t baud);
+
+//Change the baud rate once the pending output has been sent. With confirm set the
+//previous rate is restored unless a byte arrives within UART_BAUD_CONFIRM_MS.
+//Returns false if the rate is not valid
+bool uartDmaSetBaud(uint32_t baud, bool confirm);
+
+//Current baud rate
+uint32_t uartDmaBaud();
+
+#endif
@@ -0,0 +1,207 @@
+//
+//  Arduino.h
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Host stand-in for the parts of the stm32duino core and CMSIS used by the
+// firmware modules under test, so they build in the PlatformIO native environment.
+// Pins, interrupts and the SPI bus do nothing, serial output is discarded and
+// DWT->CYCCNT stays at 0.
+//
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef int BitOrder;
+
+#define HIGH     1
+#define LOW      0
+#define INPUT    0
+#define OUTPUT   1
+#define INPUT_PULLUP 2
+#define RISING   3
+#define MSBFIRST 1
+#define DEC      10
+#define HEX      16
+#define BIN      2
+#define F_CPU    72000000UL
+#define F(s)     s
+
+//Pin numbers of the LTDZ board header, port A then port B
+enum {
+  PA0, PA1, PA2, PA3, PA4, PA5, PA6, PA7, PA8, PA9, PA10, PA11, PA12, PA13, PA14, PA15,
+  PB0, PB1, PB2, PB3, PB4, PB5, PB6, PB7, PB8, PB9, PB10, PB11, PB12, PB13, PB14, PB15
+};
+
+struct GPIO_TypeDef { volatile uint32_t CRL, CRH, IDR, ODR, BSRR, BRR, LCKR; };
+extern GPIO_TypeDef hostGpio;
+inline GPIO_TypeDef *digitalPinToPort(uint32_t) { return &hostGpio; }
+inline uint32_t digitalPinToBitMask(uint32_t pin) { return 1UL << (pin & 15); }
+
+inline void pinMode(uint32_t, uint32_t) {}
+inline void digitalWrite(uint32_t, uint32_t) {}
+inline int digitalRead(uint32_t) { return LOW; }
+inline int digitalPinToInterrupt(uint32_t pin) { return pin; }
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void detachInterrupt(int) {}
+inline void delay(uint32_t) {}
+inline void delayMicroseconds(uint32_t) {}
+unsigned long micros();
+unsigned long millis();
+inline long random(long lo, long hi) { return hi > lo ? lo + rand() % (hi - lo) : lo; }
+inline char *dtostrf(double v, signed char width, unsigned char prec, char *s)
+{
+  sprintf(s, "%*.*f", width, prec, v);
+  return s;
+}
+
+//CMSIS core
+enum IRQn_Type { EXTI1_IRQn, EXTI9_5_IRQn, TIM2_IRQn, TIM3_IRQn, DMA1_Channel6_IRQn, DMA1_Channel7_IRQn, USART2_IRQn };
+inline void NVIC_EnableIRQ(IRQn_Type) {}
+inline void NVIC_DisableIRQ(IRQn_Type) {}
+inline void NVIC_SetPriority(IRQn_Type, uint32_t) {}
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+inline uint32_t __get_PRIMASK() { return 0; }
+inline void __set_PRIMASK(uint32_t) {}
+inline void __DSB() {}
+inline void __ISB() {}
+inline void __DMB() {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+struct DWT_Type { volatile uint32_t CTRL, CYCCNT; };
+struct CoreDebug_Type { volatile uint32_t DEMCR; };
+extern DWT_Type hostDwt;
+extern CoreDebug_Type hostCoreDebug;
+#define DWT (&hostDwt)
+#define CoreDebug (&hostCoreDebug)
+#define DWT_CTRL_CYCCNTENA_Msk     (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+class Print
+{
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t n)
+    {
+      size_t k = 0;
+      while (n--) {
+        k += write(*buf++);
+      }
+      return k;
+    }
+    size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    virtual int availableForWrite() { return 0; }
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long long v, int base = DEC) { return printf_("%lld", v, base); }
+    size_t print(unsigned long long v, int base = DEC) { return printf_("%llu", v, base); }
+    size_t print(int v, int base = DEC) { return print((long long)v, base); }
+    size_t print(long v, int base = DEC) { return print((long long)v, base); }
+    size_t print(unsigned int v, int base = DEC) { return print((unsigned long long)v, base); }
+    size_t print(unsigned long v, int base = DEC) { return print((unsigned long long)v, base); }
+    size_t print(unsigned char v, int base = DEC) { return print((unsigned long long)v, base); }
+    size_t print(double v, int digits = 2)
+    {
+      char buf[48];
+      snprintf(buf, sizeof(buf), "%.*f", digits, v);
+      return write(buf);
+    }
+    size_t print(const class Printable &p);
+    size_t print(const class String &s);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(const T &v, int f) { size_t n = print(v, f); return n + println(); }
+
+  private:
+    size_t printf_(const char *fmt, unsigned long long v, int base)
+    {
+      char buf[72];
+      if (base == HEX) {
+        snprintf(buf, sizeof(buf), "%llX", v);
+      } else if (base == BIN) {
+        int n = 0;
+        do {
+          buf[n++] = '0' + (v & 1);
+          v >>= 1;
+        } while (v != 0);
+        for (int i = 0; i < n / 2; i++) {
+          char c = buf[i];
+          buf[i] = buf[n - 1 - i];
+          buf[n - 1 - i] = c;
+        }
+        buf[n] = 0;
+      } else {
+        snprintf(buf, sizeof(buf), fmt, v);
+      }
+      return write(buf);
+    }
+};
+
+class Printable
+{
+  public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print &p) const = 0;
+};
+
+inline size_t Print::print(const Printable &p) { return p.printTo(*this); }
+
+//Enough of String for the register dumps
+class String : public std::string
+{
+  public:
+    String(const char *s = "") : std::string(s) {}
+    String(const std::string &s) : std::string(s) {}
+    String(uint32_t v, int base)
+    {
+      do {
+        insert(begin(), "0123456789ABCDEF"[v % base]);
+        v /= base;
+      } while (v != 0);
+    }
+    unsigned int length() const { return size(); }
+};
+inline String operator+(const char *a, const String &b) { return String(std::string(a) + b); }
+inline size_t Print::print(const String &s) { return write(s.c_str()); }
+
+//Serial ports that accept and discard everything, counting the bytes
+class HostSerial : public Print
+{
+  public:
+    using Print::write;
+    size_t write(uint8_t) override { written++; return 1; }
+    size_t write(const uint8_t *, size_t n) override { written += n; return n; }
+    int availableForWrite() override { return 1024; }
+    void begin(unsigned long) {}
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush() {}
+
+    size_t written = 0; ///< bytes written since the test last cleared it
+};
+extern HostSerial Serial, SerialUSB, Serial2;
+
+#endif
@@ -0,0 +1,30 @@
+//
+//  BitBangedSPI.h
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Host stand-in for lib/BitBangedSPI, the bus of the BigNumber reference
+// driver. Bytes written to it are dropped, the tests compare the register words.
+//
+
+#ifndef HOST_BITBANGEDSPI_H
+#define HOST_BITBANGEDSPI_H
+
+#include <Arduino.h>
+
+class bitBangedSPI
+{
+  public:
+    bitBangedSPI(uint32_t, uint32_t, uint32_t, unsigned long = 4) {}
+    void begin() {}
+    byte transfer(byte c) { return c; }
+};
+
+#endif
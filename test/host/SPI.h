@@ -0,0 +1,29 @@
+//
+//  SPI.h
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Host stand-in for the SPI library header included by adf4351.h.
+//
+
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+
+#include <Arduino.h>
+
+#define SPI_MODE0 0
+
+struct SPISettings
+{
+  SPISettings() {}
+  SPISettings(uint32_t, BitOrder, uint8_t) {}
+};
+
+#endif
@@ -0,0 +1,35 @@
+//
+//  arduino_host.cpp
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Definitions behind the host Arduino.h.
+//
+
+#include <Arduino.h>
+#include <chrono>
+
+GPIO_TypeDef hostGpio;
+DWT_Type hostDwt;
+CoreDebug_Type hostCoreDebug;
+HostSerial Serial, SerialUSB, Serial2;
+bool serialMute = false; //Defined by the board file on the target
+
+static const std::chrono::steady_clock::time_point hostStart = std::chrono::steady_clock::now();
+
+unsigned long micros()
+{
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - hostStart).count();
+}
+
+unsigned long millis()
+{
+  return micros() / 1000;
+}
@@ -0,0 +1,219 @@
+//
+//  test_mod_math.cpp
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Host tests for the fixed point LFO arithmetic (pio test -e native). Every
+// fixed point result must be the exact floor of the offset, worked out with 128 bit
+// integers. The pinned double curves of the earlier modulation loop must give the same
+// frequency, except where their own rounding lands on a whole Hz the exact value does
+// not reach. There they read 1 Hz high, which is the only difference allowed.
+//
+
+#include <unity.h>
+#include <random>
+#include "mod_math.h"
+
+#define MOD_MATH_CASES 2000000
+
+//The double curves of lfoSetpoint() before mod_math, base + offset truncated to Hz
+static uint64_t doubleScale(uint64_t base, uint32_t fraction, int32_t depth)
+{
+  return base + (double)fraction / 4294967296.0 * (double)depth;
+}
+
+static uint64_t doubleCustom(uint64_t base, int32_t sample, int32_t depth)
+{
+  return base + (double)sample / 2147483648.0 * (double)depth;
+}
+
+static uint64_t doubleTriangle(uint64_t base, uint32_t phase, int32_t depth)
+{
+  double time_period = (double)depth;
+  double time_offset = ((double)phase / 4294967296.0) * depth;
+  if (time_offset <= time_period / 2.0) {
+    return base + time_offset * 2;
+  }
+  return base + (time_period - time_offset) * 2;
+}
+
+//floor(v / 2^shift)
+static int64_t exactFloor(__int128 v, uint8_t shift)
+{
+  __int128 d = (__int128)1 << shift;
+  __int128 q = v / d;
+  if (v % d != 0 && v < 0) {
+    q--;
+  }
+  return (int64_t)q;
+}
+
+//2 * triangle offset in Q32.32, as doubleTriangle()
+static __int128 exactTriangle(uint32_t phase, int32_t depth)
+{
+  __int128 offset = (__int128)phase * depth;
+  __int128 half = (__int128)depth << 31;
+  return 2 * (offset <= half ? offset : ((__int128)depth << 32) - offset);
+}
+
+struct Tally
+{
+  uint32_t cases ;
+  uint32_t inexact ;   ///< fixed point results that are not the exact floor
+  uint32_t deviation ; ///< double 1 Hz high where its rounding crossed a whole Hz
+  uint32_t mismatch ;  ///< any other difference from the double curve
+  char first[128] ;
+};
+
+//fixed and double are base + offset, exact the offset in Q32.32
+static void check(Tally &t, const char *name, uint64_t base, __int128 exact, uint64_t fixed, uint64_t dbl)
+{
+  int64_t floor = exactFloor(exact, 32);
+  if ((int64_t)base + floor < 0) {
+    return; //A negative frequency, out of range for both
+  }
+  t.cases++;
+  uint64_t want = base + floor;
+  if (fixed != want) {
+    t.inexact++;
+  }
+  if (dbl == fixed) {
+    return;
+  }
+  //Allowed only when the exact value is within one double ulp below the next whole Hz
+  __int128 gap = ((__int128)(floor + 1) << 32) - exact;
+  double ulp = (double)(base + floor + 1) * 2.3e-16;
+  if (dbl == want + 1 && (double)gap / 4294967296.0 <= ulp) {
+    t.deviation++;
+    return;
+  }
+  if (t.mismatch++ == 0) {
+    snprintf(t.first, sizeof(t.first), "%s: base %llu, fixed %llu, double %llu", name,
+             (unsigned long long)base, (unsigned long long)fixed, (unsigned long long)dbl);
+  }
+}
+
+static void report(const char *name, const Tally &t)
+{
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%s: %lu cases, %lu 1 Hz double rounding deviations", name,
+           (unsigned long)t.cases, (unsigned long)t.deviation);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, t.inexact, "fixed point result is not the exact floor");
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, t.mismatch, t.first);
+}
+
+//Output frequency and a depth of up to +/-40 MHz, every other case within +/-10 kHz
+static void randomCase(std::mt19937_64 &rng, uint32_t i, uint64_t &base, int32_t &depth)
+{
+  base = 35000000ULL + rng() % 4365000000ULL;
+  if (i & 1) {
+    depth = (int32_t)(rng() % 20001) - 10000;
+  } else {
+    depth = (int32_t)(rng() % 80000001) - 40000000;
+  }
+}
+
+void test_ramp_and_sine_match_double()
+{
+  std::mt19937_64 rng(23);
+  Tally t = {};
+  for (uint32_t i = 0; i < MOD_MATH_CASES; i++) {
+    uint64_t base;
+    int32_t depth;
+    randomCase(rng, i, base, depth);
+    uint32_t fraction = rng();
+    if (i % 4 == 3) {
+      fraction = 0xFFFFFFFFUL - rng() % 4; //Just under a whole depth
+    }
+    check(t, "q32Scale", base, (__int128)fraction * depth, base + q32Scale(fraction, depth),
+          doubleScale(base, fraction, depth));
+  }
+  report("q32Scale", t);
+}
+
+void test_custom_matches_double()
+{
+  std::mt19937_64 rng(24);
+  Tally t = {};
+  for (uint32_t i = 0; i < MOD_MATH_CASES; i++) {
+    uint64_t base;
+    int32_t depth;
+    randomCase(rng, i, base, depth);
+    int32_t sample = (int32_t)rng();
+    if (i % 4 == 3) {
+      sample = (int32_t)(0x7FFFFFFFUL - rng() % 4); //Full scale, just under a whole depth
+    }
+    //sample / 2^31 is sample * 2 / 2^32
+    check(t, "q31Scale", base, (__int128)sample * depth * 2, base + q31Scale(sample, depth),
+          doubleCustom(base, sample, depth));
+  }
+  report("q31Scale", t);
+}
+
+void test_triangle_matches_double()
+{
+  std::mt19937_64 rng(25);
+  Tally t = {};
+  for (uint32_t i = 0; i < MOD_MATH_CASES; i++) {
+    uint64_t base;
+    int32_t depth;
+    randomCase(rng, i, base, depth);
+    uint32_t phase = rng();
+    if (i % 4 == 3) {
+      phase = 0x80000000UL + (int32_t)(rng() % 5) - 2; //Around the half cycle compare
+    }
+    __int128 exact = exactTriangle(phase, depth);
+    if ((int64_t)base + exactFloor(exact, 32) < 0) {
+      continue; //doubleTriangle() would convert a negative double to uint64_t
+    }
+    check(t, "triangleOffset", base, exact, base + triangleOffset(phase, depth),
+          doubleTriangle(base, phase, depth));
+  }
+  report("triangleOffset", t);
+}
+
+void test_q32mul_is_exact()
+{
+  std::mt19937_64 rng(26);
+  uint32_t inexact = 0;
+  for (uint32_t i = 0; i < MOD_MATH_CASES; i++) {
+    //Glide spans are differences of two frequencies, well inside 2^40
+    int64_t value = (int64_t)(rng() % (1ULL << 41)) - (1LL << 40);
+    if (i % 16 == 0) {
+      value = (int64_t)rng();
+    }
+    uint32_t fraction = rng();
+    if (q32Mul(value, fraction) != exactFloor((__int128)value * fraction, 32)) {
+      inexact++;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, inexact);
+}
+
+void test_benchmark_cases_match()
+{
+  uint32_t fixed_cycles, double_cycles;
+  TEST_ASSERT_EQUAL_UINT32(0, modMathBenchmark(1000, fixed_cycles, double_cycles));
+}
+
+void setUp() {}
+void tearDown() {}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_ramp_and_sine_match_double);
+  RUN_TEST(test_custom_matches_double);
+  RUN_TEST(test_triangle_matches_double);
+  RUN_TEST(test_q32mul_is_exact);
+  RUN_TEST(test_benchmark_cases_match);
+  return UNITY_END();
+}
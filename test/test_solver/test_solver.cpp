@@ -0,0 +1,329 @@
+//
+//  test_solver.cpp
+//
+//  Author:  Martin Timms
+//  Date:    14th July 2023.
+//  Contributors:
+//  Version: 1.0
+//
+//  Released into the public domain.
+//
+//  License: MIT License
+//
+// Description: Host tests for the integer PLL solver (pio test -e native). setf_only() must
+// give the same return code and R0-R5 words as the pinned BigNumber driver for every
+// frequency, reference setting and channel step tried, and the solve times of both are
+// reported. Run on the host, the times only show the ratio between the two. The PLL
+// values reported by I must also follow register table playback, and the driver reports
+// must only reach the port of the session that asked for them. plan() must find a FRAC/MOD
+// as close as a search of every MOD, report the error and frequency it generates, and
+// agree with the retuneFrac() fast path.
+//
+
+#include <unity.h>
+#include <chrono>
+#include <random>
+#include "adf4351.h"
+#include "brd_ltdz_stm32f103cb.h"
+#include "bignumber_adf4351.h"
+#include "reg_table.h"
+#include "serial_tx.h"
+
+#define SOLVER_FREQS_PER_REF 262144 ///< frequencies per reference setting, 2M in total
+#define SOLVER_TIMED_SOLVES  20000
+#define SOLVER_PLANS_PER_REF 2048   ///< plan() results searched for a closer FRAC/MOD
+#define SOLVER_STEPS_PER_REF 256    ///< retuneFrac() steps compared with plan()
+
+struct RefSetting
+{
+  uint32_t reffreq ;
+  int RCounter ;
+  uint8_t RD2refdouble ;
+  uint8_t RD1Rdiv2 ;
+};
+
+static const RefSetting refSettings[] = {
+  { 25000000, 1, 0, 0 }, { 10000000, 1, 0, 0 }, { 25000000, 3, 0, 0 }, { 25000000, 1, 1, 1 },
+  { 25000000, 7, 1, 0 }, { 100000000, 4, 0, 0 }, { 122880000, 5, 0, 1 }, { 26000000, 1, 0, 0 }
+};
+
+template <class T> static void applyRef(T &vfo, const RefSetting &r)
+{
+  vfo.reffreq = r.reffreq;
+  vfo.RCounter = r.RCounter;
+  vfo.RD2refdouble = r.RD2refdouble;
+  vfo.RD1Rdiv2 = r.RD1Rdiv2;
+}
+
+//Any Hz, whole kHz and 100 kHz +/-1 Hz in turn, the last two hit the exact and
+//reducible FRAC/MOD cases that random Hz rarely does
+static uint32_t testFrequency(std::mt19937_64 &rng, uint32_t i)
+{
+  uint64_t f;
+  switch (i % 3) {
+    case 0:
+      f = ADF_FREQ_MIN + rng() % (4294967296ULL - ADF_FREQ_MIN);
+      break;
+    case 1:
+      f = (ADF_FREQ_MIN / 1000 + rng() % 4260000) * 1000;
+      break;
+    default:
+      f = (ADF_FREQ_MIN / 100000 + rng() % 42600) * 100000 + rng() % 3 - 1;
+      break;
+  }
+  return f > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)f;
+}
+
+void test_setf_only_matches_bignumber()
+{
+  std::mt19937_64 rng(4351);
+  uint32_t solves = 0;
+  uint32_t mismatches = 0;
+  char first[160] = "";
+
+  for (const RefSetting &r : refSettings) {
+    BigNumberADF4351 ref(PIN_SS, SPI_MODE0, 1000000UL, MSBFIRST);
+    ADF4351 vfo(PIN_SS, SPI_MODE0, 1000000UL, MSBFIRST);
+    vfo.init();
+    applyRef(ref, r);
+    applyRef(vfo, r);
+    for (uint32_t i = 0; i < SOLVER_FREQS_PER_REF; i++) {
+      uint32_t f = testFrequency(rng, i);
+      uint32_t step = rng() % 16;
+      int a = ref.setf_only(f, step);
+      int b = vfo.setf_only(f, step);
+      bool same = a == b;
+      for (uint8_t n = 0; n < 6; n++) {
+        same = same && ref.R[n].whole == vfo.R[n].whole;
+      }
+      solves++;
+      if (!same) {
+        if (mismatches == 0) {
+          snprintf(first, sizeof(first), "first mismatch: ref %lu Hz R %d, %lu Hz step %lu, return %d/%d",
+                   (unsigned long)r.reffreq, r.RCounter, (unsigned long)f, (unsigned long)step, a, b);
+        }
+        mismatches++;
+      }
+    }
+  }
+  char msg[64];
+  snprintf(msg, sizeof(msg), "%lu frequencies compared", (unsigned long)solves);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, mismatches, first);
+}
+
+void test_solve_time()
+{
+  BigNumberADF4351 ref(PIN_SS, SPI_MODE0, 1000000UL, MSBFIRST);
+  ADF4351 vfo(PIN_SS, SPI_MODE0, 1000000UL, MSBFIRST);
+  vfo.init();
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < SOLVER_TIMED_SOLVES; i++) {
+    ref.setf_only(100000000UL + i * 37, i % 16);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < SOLVER_TIMED_SOLVES; i++) {
+    vfo.setf_only(100000000UL + i * 37, i % 16);
+  }
+  auto t2 = std::chrono::steady_clock::now();
+
+  double bigNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / SOLVER_TIMED_SOLVES;
+  double intNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / SOLVER_TIMED_SOLVES;
+  char msg[96];
+  snprintf(msg, sizeof(msg), "setf_only ns per solve, BigNumber/integer: %.0f/%.0f (%.1fx)", bigNs, intNs, bigNs / intNs);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_TRUE(intNs < bigNs);
+}
+
+//Distance of n + frac / mod from the exact VCO / PFD ratio n0 + rem / pfd, times mod * pfd
+static uint64_t fracError(uint64_t n0, uint64_t rem, uint64_t pfd, uint64_t n, uint64_t frac, uint64_t mod)
+{
+  __int128 e = ((__int128)n - n0) * mod * pfd + (__int128)frac * pfd - (__int128)rem * mod;
+  return (uint64_t)(e < 0 ? -e : e);
+}
+
+void test_plan_matches_mod_search()
+{
+  std::mt19937_64 rng(2);
+  uint32_t plans = 0;
+  uint32_t worse = 0;
+  char first[160] = "";
+
+  for (const RefSetting &r : refSettings) {
+    ADF4351 vfo(PIN_SS, SPI_MODE0, 1000000UL, MSBFIRST);
+    vfo.init();
+    applyRef(vfo, r);
+    PLLPlan p;
+    vfo.plan(ADF_FREQ_MIN, p); //brings PFDmHz up to date
+    const uint64_t pfd = vfo.PFDmHz;
+    for (uint32_t i = 0; i < SOLVER_PLANS_PER_REF; i++) {
+      uint64_t f = testFrequency(rng, i);
+      if (i % 4 == 3) {
+        //a whole INT +/-1 Hz, FRAC rounds to 0 or up to the next INT
+        f = (ADF_FREQ_MIN * 1000 / pfd + 1 + rng() % (ADF_FREQ_MAX * 1000 / pfd - ADF_FREQ_MIN * 1000 / pfd)) * pfd / 1000 + rng() % 3 - 1;
+      }
+      if (f < ADF_FREQ_MIN || f > ADF_FREQ_MAX) continue;
+      TEST_ASSERT_EQUAL_INT(0, vfo.plan(f, p));
+      TEST_ASSERT_TRUE(p.Mod >= 2 && p.Mod <= ADF_MOD_MAX && p.Frac < p.Mod);
+      uint64_t div = 1ULL << p.RfDivSel;
+      uint64_t vco = f * div * 1000;
+      uint64_t n0 = vco / pfd, rem = vco % pfd;
+
+      //every MOD with its closest FRAC, FRAC = MOD is the next INT
+      uint64_t bestErr = pfd, bestMod = 1;
+      for (uint64_t mod = 2; mod <= ADF_MOD_MAX; mod++) {
+        uint64_t frac = (rem * mod + pfd / 2) / pfd;
+        uint64_t e = fracError(n0, rem, pfd, n0, frac, mod);
+        if (e * bestMod < bestErr * mod) {
+          bestErr = e;
+          bestMod = mod;
+        }
+      }
+      uint64_t e = fracError(n0, rem, pfd, p.N_Int, p.Frac, p.Mod);
+      plans++;
+      if (e * bestMod > bestErr * p.Mod) {
+        if (worse == 0) {
+          snprintf(first, sizeof(first), "first worse plan: ref %lu Hz R %d, %llu Hz, %u/%u, search MOD %llu",
+                   (unsigned long)r.reffreq, r.RCounter, (unsigned long long)f, p.Frac, p.Mod, (unsigned long long)bestMod);
+        }
+        worse++;
+      }
+
+      //the frequency generated, PFD * ( INT + FRAC / MOD ) / outdiv
+      __int128 gen = (__int128)pfd * ((__int128)p.N_Int * p.Mod + p.Frac);
+      __int128 scale = (__int128)p.Mod * div;
+      TEST_ASSERT_EQUAL_INT32((int32_t)((gen - (__int128)f * 1000 * scale) / scale), p.ferr_mHz);
+      TEST_ASSERT_EQUAL_UINT64((uint64_t)(gen / (scale * 1000)), p.cfreq);
+      if (bestErr == 0) {
+        TEST_ASSERT_EQUAL_INT32(0, p.ferr_mHz);
+        TEST_ASSERT_EQUAL_UINT64(f, p.cfreq);
+      }
+    }
+  }
+  char msg[64];
+  snprintf(msg, sizeof(msg), "%lu plans searched", (unsigned long)plans);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, worse, first);
+}
+
+void test_retune_frac_matches_plan()
+{
+  std::mt19937_64 rng(3);
+  uint32_t retunes = 0;
+
+  for (const RefSetting &r : refSettings) {
+    ADF4351 vfo(PIN_SS, SPI_MODE0, 1000000UL, MSBFIRST);
+    vfo.init();
+    applyRef(vfo, r);
+    uint64_t f = (ADF_FREQ_MIN / 1000 + 1000 + rng() % 4250000) * 1000;
+    TEST_ASSERT_EQUAL_INT(0, vfo.optimise_f_only(f));
+    for (uint32_t i = 0; i < SOLVER_STEPS_PER_REF; i++) {
+      //whole kHz steps, most of them hit by the current MOD
+      f += (rng() % 2001) * 1000 - 1000000;
+      if (f < ADF_FREQ_MIN || f > ADF_FREQ_MAX) continue;
+      PLLPlan p;
+      TEST_ASSERT_EQUAL_INT(0, vfo.plan(f, p));
+      if (vfo.retuneFrac(f) != 0) {
+        TEST_ASSERT_EQUAL_INT(0, vfo.setPlan(p));
+        continue;
+      }
+      retunes++;
+      TEST_ASSERT_EQUAL_UINT64(p.cfreq, vfo.cfreq);
+      TEST_ASSERT_EQUAL_INT32(p.ferr_mHz, vfo.ferr_mHz);
+      TEST_ASSERT_EQUAL_UINT32(p.RfDivSel, vfo.RfDivSel);
+      TEST_ASSERT_EQUAL_UINT64((uint64_t)p.N_Int * p.Mod + p.Frac, ((uint64_t)vfo.N_Int * vfo.Mod + vfo.Frac) * p.Mod / vfo.Mod);
+    }
+  }
+  char msg[64];
+  snprintf(msg, sizeof(msg), "%lu delta FRAC retunes compared", (unsigned long)retunes);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_TRUE(retunes > 0);
+}
+
+void test_playback_updates_pll_values()
+{
+  static RegTable table;
+  ADF4351 vfo(PIN_SS, SPI_MODE0, 1000000UL, MSBFIRST);
+  vfo.init();
+  std::mt19937_64 rng(7);
+  PLLPlan plans[64];
+  table.clear();
+  for (PLLPlan &p : plans) {
+    TEST_ASSERT_EQUAL_INT(0, vfo.plan(ADF_FREQ_MIN + rng() % (ADF_FREQ_MAX - ADF_FREQ_MIN), p));
+    TEST_ASSERT_TRUE(table.add(vfo, p));
+  }
+  vfo.optimise_f_only(100000000ULL);
+  for (uint16_t i = 0; i < 64; i++) {
+    const PLLPlan &p = plans[(i * 37) % 64];
+    table.play(vfo, (i * 37) % 64);
+    vfo.syncFromRegisters();
+    TEST_ASSERT_EQUAL_UINT64(p.cfreq, vfo.cfreq);
+    TEST_ASSERT_EQUAL_UINT32(p.N_Int, vfo.N_Int);
+    TEST_ASSERT_EQUAL_UINT32(p.Frac, vfo.Frac);
+    TEST_ASSERT_EQUAL_UINT32(p.Mod, vfo.Mod);
+    TEST_ASSERT_EQUAL_UINT32(1UL << p.RfDivSel, vfo.outdiv);
+    TEST_ASSERT_EQUAL_UINT32(p.Prescaler, vfo.Prescaler);
+  }
+}
+
+//In band steps the current MOD does not hit must be answered by the plan cache, steps it
+//does hit take the delta FRAC retune
+void test_in_band_steps_use_plan_cache()
+{
+  ADF4351 vfo(PIN_SS, SPI_MODE0, 1000000UL, MSBFIRST);
+  vfo.init();
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_INT(0, vfo.optimise_f_only(433920123ULL));
+    TEST_ASSERT_EQUAL_INT(0, vfo.optimise_f_only(433920457ULL));
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, vfo.planCacheMisses);
+  TEST_ASSERT_EQUAL_UINT32(4, vfo.planCacheHits);
+  TEST_ASSERT_EQUAL_UINT32(0, vfo.fracRetunes);
+  TEST_ASSERT_EQUAL_INT(0, vfo.optimise_f_only(433925000ULL));
+  uint16_t mod = vfo.Mod;
+  TEST_ASSERT_EQUAL_INT(0, vfo.optimise_f_only(433925000ULL + 25000));
+  TEST_ASSERT_EQUAL_UINT32(1, vfo.fracRetunes);
+  TEST_ASSERT_EQUAL_UINT32(3, vfo.planCacheMisses);
+  TEST_ASSERT_EQUAL_UINT32(mod, vfo.Mod);
+  TEST_ASSERT_EQUAL_UINT64(433925000ULL + 25000, vfo.cfreq);
+}
+
+//A UART session's I, R and F replies must not put a byte on USB, where a USB session
+//may be in binary mode
+void test_reports_follow_session_route()
+{
+  ADF4351 vfo(PIN_SS, SPI_MODE0, 1000000UL, MSBFIRST);
+  vfo.init();
+  vfo.optimise_f_only(100000000ULL);
+  serialTx.service();
+  Serial.written = SerialUSB.written = Serial2.written = 0;
+  serialTx.route = SERIAL_PORT_UART;
+  vfo.optimise_f_only(100000001ULL, true, true);  //in band step
+  vfo.optimise_f_only(2000000000ULL, true, true); //new divider, full plan
+  vfo.optimise_f_only(1ULL, true, true);          //out of range
+  vfo.freqInfo();
+  vfo.regInfo();
+  serialTx.route = SERIAL_PORT_ALL;
+  serialTx.service();
+  TEST_ASSERT_EQUAL_UINT32(0, serialTx.usb.used());
+  TEST_ASSERT_EQUAL_UINT32(0, SerialUSB.written);
+  TEST_ASSERT_EQUAL_UINT32(0, Serial.written);
+  TEST_ASSERT_TRUE(Serial2.written > 0);
+}
+
+void setUp() {}
+void tearDown() {}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_setf_only_matches_bignumber);
+  RUN_TEST(test_solve_time);
+  RUN_TEST(test_plan_matches_mod_search);
+  RUN_TEST(test_retune_frac_matches_plan);
+  RUN_TEST(test_playback_updates_pll_values);
+  RUN_TEST(test_in_band_steps_use_plan_cache);
+  RUN_TEST(test_reports_follow_session_route);
+  return UNITY_END();
+}